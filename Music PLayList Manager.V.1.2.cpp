@@ -2,7 +2,7 @@
 #include <string>
 #include <list>
 #include <queue>
-#include <stack>
+#include <deque>
 #include <algorithm>
 #include <vector>
 #include <functional>
@@ -11,13 +11,41 @@
 #include <sstream>
 #include <chrono>
 #include <ctime>
+#include <unordered_map>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string_view>
+#include <memory>
+#include <cstring>
+#include <climits>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+// range of the star ratings
+constexpr int kMinRating = 1;
+constexpr int kMaxRating = 5;
+
 // Song structure
 struct Song {
     std::string title;
     std::string artist;
     int rating;  // 1 to 5 stars
 
-    Song(std::string t, std::string a, int r) : title(t), artist(a), rating(r) {}
+    Song(std::string t, std::string a, int r) : title(std::move(t)), artist(std::move(a)), rating(r) {}
 
     // for saving to file, convert song to a string format
     std::string toString() const {
@@ -28,348 +56,4430 @@ struct Song {
     static Song fromString(const std::string& str) {
         std::stringstream ss(str);
         std::string title, artist;
-        int rating;
+        int rating = 0;
         std::getline(ss, title, ',');
         std::getline(ss, artist, ',');
         ss >> rating;
-        return Song(title, artist, rating); // return the Song object 'title', 'artist', and 'rating'
+        return Song(std::move(title), std::move(artist), rating); // return the Song object 'title', 'artist', and 'rating'
     }
 };
 
-// UndoAction class to store undoable actions (add or remove)
-struct UndoAction { //-https://www.w3schools.com/cpp/cpp_enum.asp
-
-   enum class ActionType { ADD, REMOVE }; // enum class to define the type of action being tracked: ADD or REMOVE
-    ActionType actionType;
-    Song song;
+// Read-only memory map of a whole file, so loaders can parse it in place without copying it into strings
+class MappedFile {
+private:
+    const char* base = nullptr;
+    std::size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
 
-    UndoAction(ActionType action, const Song& s) : actionType(action), song(s) {} 
-};
+public:
+    explicit MappedFile(const std::string& filename) {
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) return;
+        opened = true;
+        length = std::size_t(size.QuadPart);
+        if (length == 0) return; // an empty file cannot be mapped, it is just an empty view
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) != 0) return;
+        opened = true;
+        length = std::size_t(info.st_size);
+        if (length == 0) return; // an empty file cannot be mapped, it is just an empty view
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            base = static_cast<const char*>(mapped);
+            madvise(mapped, length, MADV_SEQUENTIAL); // read front to back once
+        }
+#endif
+        if (!base) { // mapping failed
+            opened = false;
+            length = 0;
+        }
+    }
 
-// Comparator for priority queue to sort by rating
-struct CompareSongRating {
-    bool operator()(const Song& a, const Song& b) {
-        return a.rating < b.rating;  // higher ratings have higher priority
+    ~MappedFile() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (base) munmap(const_cast<char*>(base), length);
+        if (fd >= 0) close(fd);
+#endif
     }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return opened; }
+    std::string_view data() const { return std::string_view(base, length); }
 };
 
-// Linked list for managing songs in a playlist
-class Playlist {
+// File opened for writing at its end, with an explicit flush to disk (fsync / FlushFileBuffers),
+// so the journal knows when its records are safe
+class DurableFile {
 private:
-    std::list<Song> songs;   // doubly linked list that stores the songs
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
 
-    // function to convert a string to lowercase
-    std::string toLowerCase(const std::string& str) const {
-        std::string lowerStr = str;
-        std::transform(lowerStr.begin(), lowerStr.end(), lowerStr.begin(), ::tolower);
-        return lowerStr;
+public:
+    DurableFile() = default;
+    ~DurableFile() { close(); }
+    DurableFile(const DurableFile&) = delete;
+    DurableFile& operator=(const DurableFile&) = delete;
+
+    // open for appending, creating the file if needed; truncate empties it first
+    bool open(const std::string& filename, bool truncate) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+#endif
+        return isOpen();
     }
 
-public:
-    // Add song to playlist
-    void addSong(const Song& song) {
-        songs.push_back(song); 
-        std::cout << "Song '" << song.title << "' by " << song.artist << " added to the playlist.\n";
+    void close() {
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
     }
 
-    // Remove song from playlist by title
-    void removeSong(const std::string& songTitle) {
-        std::string lowerTitle = toLowerCase(songTitle); 
-        for (auto it = songs.begin(); it != songs.end(); ++it) {   
-            std::string itlower = toLowerCase(it->title);
-            if (itlower== lowerTitle) { 
-                std::cout << "Song '" << it->title << "' removed from the playlist.\n";
-                songs.erase(it);   
-                return;   // Exit the function once the song is removed
+#ifdef _WIN32
+    bool isOpen() const { return file != INVALID_HANDLE_VALUE; }
+#else
+    bool isOpen() const { return fd >= 0; }
+#endif
+
+    // write the bytes at the end of the file (they may still sit in the OS cache until sync)
+    bool append(std::string_view data) {
+        while (!data.empty()) {
+#ifdef _WIN32
+            LARGE_INTEGER end = {};
+            DWORD written = 0;
+            DWORD chunk = DWORD(std::min<std::size_t>(data.size(), 1u << 30));
+            if (!SetFilePointerEx(file, end, nullptr, FILE_END) || !WriteFile(file, data.data(), chunk, &written, nullptr)) return false;
+#else
+            ssize_t written = ::write(fd, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
             }
+#endif
+            data.remove_prefix(std::size_t(written));
         }
-        //if not found to the list
-        std::cout << "Song '" << songTitle<< "' not found in the playlist.\n";
+        return true;
     }
 
-    // Display all songs in playlist
-    void displayPlaylist() const {
-        if (songs.empty()) {  
-            std::cout << "The playlist is empty.\n";
-            return;
-        }
-        std::cout << "********** PLAYLIST **********\n";
-        std::cout << std::setw(35) << std::left << "TITLE"
-            << std::setw(20) << std::left << "ARTIST"
-            << std::setw(10) << std::right << "RATING\n";
-        std::cout << std::setfill('-') << std::setw(65) << "" << std::setfill(' ') << '\n'; 
-        // iterate over the songs and display their details
-        for (const auto& s : songs)  
-            std::cout << std::setw(35) << std::left << s.title
-            << std::setw(20) << std::left << s.artist
-            << std::setw(5) << std::right << "[ " << s.rating << "/5 ] \n";
+    // block until everything written so far is on disk
+    bool sync() {
+#ifdef _WIN32
+        return FlushFileBuffers(file) != 0;
+#else
+        return ::fsync(fd) == 0;
+#endif
     }
+};
 
-    // Search for a song by title
-    bool searchSong(const std::string& title) const {
-        bool found = false;
-        std::string lowerTitle = toLowerCase(title);
-        // convert input to lowercase
-     
-        for (const auto& song : songs) { 
-            std::string lowerSongTitle = toLowerCase(song.title);
-            if (lowerSongTitle.find(lowerTitle) != std::string::npos) { // check if the song title contains the search string
-                std::cout << "Song found: " << song.title << " by " << song.artist << "\n";
-                found = true;
-            }
-        }
-        if (!found)  std::cout << "No song found with the title containing: " << title << "\n";
-        return found;
+// replace the file 'to' by 'from' in one step, so a reader sees either the old or the new file
+bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (std::rename(from.c_str(), to.c_str()) != 0) return false;
+    // the rename itself lives in the directory, which needs its own fsync to survive a crash
+    std::size_t slash = to.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : to.substr(0, slash + 1);
+    int dirFd = ::open(directory.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
     }
+    return true;
+#endif
+}
 
-    // sort the songs by rating (high to low)
-    void sortByRating() {
-        // usse the list sort function with a custom comparison (rating in descending order)
-        songs.sort([](const Song& a, const Song& b) { return a.rating > b.rating; });
-        std::cout << "Playlist sorted by rating (high to low).\n";
+// one "title,artist,rating" line split in place: the views point into the file buffer
+struct SongFields {
+    std::string_view title;
+    std::string_view artist;
+    int rating = 0;
+};
+
+// split a line the same way Song::fromString does (first comma ends the title, second ends the artist),
+// without allocating; the artist is kept as written, trailing spaces included
+// returns false when the line has no readable rating
+bool parseSongFields(std::string_view line, SongFields& fields) {
+    std::size_t firstComma = line.find(',');
+    if (firstComma == std::string_view::npos) return false;
+    std::size_t secondComma = line.find(',', firstComma + 1);
+    if (secondComma == std::string_view::npos) return false;
+    fields.title = line.substr(0, firstComma);
+    fields.artist = line.substr(firstComma + 1, secondComma - firstComma - 1);
+
+    std::string_view ratingText = line.substr(secondComma + 1);
+    while (!ratingText.empty() && (ratingText.front() == ' ' || ratingText.front() == '\t')) ratingText.remove_prefix(1);
+    auto parsed = std::from_chars(ratingText.data(), ratingText.data() + ratingText.size(), fields.rating);
+    return parsed.ec == std::errc();
+}
+
+// call fn(fields) for every song line of a whole playlist file
+// drops UTF-8 byte order marks at the start of a line (priority.txt has one in the middle, left by
+// pasting files together), Windows line endings and blank lines; returns how many lines could not be read
+template <typename Fn>
+std::size_t forEachSongLine(std::string_view data, Fn fn) {
+    std::size_t skipped = 0;
+    SongFields fields;
+    while (!data.empty()) {
+        std::size_t end = data.find('\n');
+        std::string_view line = data.substr(0, end);
+        data.remove_prefix(end == std::string_view::npos ? data.size() : end + 1);
+        if (line.substr(0, 3) == "\xEF\xBB\xBF") line.remove_prefix(3);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) continue;
+        if (parseSongFields(line, fields)) fn(fields);
+        else ++skipped;
     }
+    return skipped;
+}
 
-    // Generate playlist based on rating preference
-    void generateTopPlaylist(int ratingWantToDisplay) {
-        std::cout << "Songs with rating >= " << ratingWantToDisplay << ":\n";
-        std::cout << std::setw(35) << std::left << "TITLE"
-            << std::setw(20) << std::left << "ARTIST"
-            << std::setw(10) << std::right << "RATING\n";
-        std::cout << std::setfill('-') << std::setw(65) << "" << std::setfill(' ') << '\n'; 
-       
-        // Iterate through all songs and display those with a rating >= rate you want to display
-        for (const auto& s : songs) {
-            if (s.rating >= ratingWantToDisplay)
-                std::cout << std::setw(35) << std::left << s.title
-                << std::setw(20) << std::left << s.artist
-                << std::setw(5) << std::right << "[ " << s.rating << "/5 ] \n";
-        } 
-       
-            
+// case-insensitive comparison without building lowercase copies
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i)
+        if (::tolower(static_cast<unsigned char>(a[i])) != ::tolower(static_cast<unsigned char>(b[i]))) return false;
+    return true;
+}
+
+// does the text contain the lowercase needle, ignoring case (an empty needle is in every text)
+inline bool containsIgnoreCase(std::string_view text, std::string_view lowerNeedle) {
+    return std::search(text.begin(), text.end(), lowerNeedle.begin(), lowerNeedle.end(),
+        [](char a, char b) { return ::tolower(static_cast<unsigned char>(a)) == b; }) != text.end();
+}
+
+// the text without the spaces and tabs around it (they are not part of a title or an artist)
+inline std::string_view trimmed(std::string_view text) {
+    std::size_t first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) return std::string_view();
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+// milliseconds elapsed since a steady_clock time point
+inline long long elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ---------- Operation stats ----------
+// counters and latency histograms for the main operations, off unless the program is started with
+// --stats (or they are turned on from the menu or a batch script); while off, each probe is one relaxed
+// load of a flag and the clock is never read. Shown by menu option 18 and the batch "stats" command,
+// and written to a file at exit (--stats [file], stats.txt by default)
+// every value is a relaxed atomic, so the concurrent playlist's threads can record at the same time
+
+enum class Operation {
+    PLAYLIST_ADD, PLAYLIST_REMOVE, PLAYLIST_SEARCH, PLAYLIST_SORT, PLAYLIST_LOAD, PLAYLIST_SAVE,
+    UNDO, REDO, QUEUE_ADD, QUEUE_REMOVE, QUEUE_TOP, QUEUE_LOAD, QUEUE_SAVE,
+    COUNT
+};
+
+enum class Counter {
+    SONGS_ADDED, SONGS_REMOVED, SONGS_SCANNED, BYTES_READ, BYTES_WRITTEN, QUEUE_ENTRIES_COPIED,
+    COUNT
+};
+
+class OperationStats {
+private:
+    static constexpr std::size_t kOperations = std::size_t(Operation::COUNT);
+    static constexpr std::size_t kCounters = std::size_t(Counter::COUNT);
+    static constexpr int kBuckets = 64;  // bucket b holds latencies in [2^(b-1), 2^b) ns, bucket 0 is 0 ns
+
+    struct Histogram {
+        std::atomic<std::uint64_t> buckets[kBuckets] = {};
+        std::atomic<std::uint64_t> count{ 0 };
+        std::atomic<std::uint64_t> totalNs{ 0 };
+        std::atomic<std::uint64_t> maxNs{ 0 };
+    };
+
+    std::atomic<bool> on{ false };
+    Histogram histograms[kOperations];
+    std::atomic<std::uint64_t> counters[kCounters] = {};
+
+    static const char* nameOf(Operation op) {
+        static const char* const names[kOperations] = {
+            "playlist.add", "playlist.remove", "playlist.search", "playlist.sort", "playlist.load", "playlist.save",
+            "undo", "redo", "queue.add", "queue.remove", "queue.top", "queue.load", "queue.save" };
+        return names[std::size_t(op)];
     }
 
-    // find song by title (for undo action)
-    Song findSong(const std::string& title) const {
-        for (const auto& song : songs) {    
-            if (toLowerCase(song.title) == toLowerCase(title))return song; 
+    static const char* nameOf(Counter counter) {
+        static const char* const names[kCounters] = {
+            "songs added", "songs removed", "songs scanned by searches", "bytes read", "bytes written",
+            "queue entries copied for top lists" };
+        return names[std::size_t(counter)];
+    }
+
+    static int bucketOf(std::uint64_t ns) {
+        int bucket = 0;
+        while (ns > 0 && bucket < kBuckets - 1) {
+            ns >>= 1;
+            ++bucket;
         }
-        return Song("", "", 0);  // Return empty song if not found
+        return bucket;
     }
 
-    // Save the playlist to a file
-    void saveToFile(const std::string& filename) const {
-        std::ofstream outFile(filename); //ofstream	Creates and writes to files
-        if (!outFile) {                                             // from cppreferencce
-            std::cerr << "Error opening file for writing.\n";       //cerr means "character error (stream)"
-            return;                       //return if no found file
+    // upper bound (ns) of the bucket holding the given fraction of the samples
+    std::uint64_t percentileNs(const Histogram& h, double fraction) const {
+        std::uint64_t wanted = std::uint64_t(std::ceil(fraction * double(h.count.load(std::memory_order_relaxed))));
+        std::uint64_t seen = 0;
+        for (int b = 0; b < kBuckets; ++b) {
+            seen += h.buckets[b].load(std::memory_order_relaxed);
+            if (seen >= wanted && seen > 0) return b == 0 ? 0 : std::min(std::uint64_t(1) << b, h.maxNs.load(std::memory_order_relaxed));
         }
-        // write each song details to the file (using the Song class toString method)
-        for (const auto& song : songs) {
-            outFile << song.toString() << "\n";
+        return h.maxNs.load(std::memory_order_relaxed);
+    }
+
+public:
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+    void setEnabled(bool enable) { on.store(enable, std::memory_order_relaxed); }
+
+    void record(Operation op, std::uint64_t ns) {
+        Histogram& h = histograms[std::size_t(op)];
+        h.buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        h.count.fetch_add(1, std::memory_order_relaxed);
+        h.totalNs.fetch_add(ns, std::memory_order_relaxed);
+        std::uint64_t seen = h.maxNs.load(std::memory_order_relaxed);
+        while (ns > seen && !h.maxNs.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+    }
+
+    void count(Counter counter, std::uint64_t amount = 1) {
+        if (enabled()) counters[std::size_t(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    std::uint64_t value(Counter counter) const { return counters[std::size_t(counter)].load(std::memory_order_relaxed); }
+    std::uint64_t calls(Operation op) const { return histograms[std::size_t(op)].count.load(std::memory_order_relaxed); }
+
+    void reset() {
+        for (Histogram& h : histograms) {
+            for (auto& bucket : h.buckets) bucket.store(0, std::memory_order_relaxed);
+            h.count.store(0, std::memory_order_relaxed);
+            h.totalNs.store(0, std::memory_order_relaxed);
+            h.maxNs.store(0, std::memory_order_relaxed);
         }
-        outFile.close();
-        std::cout << "Playlist saved to " << filename << "\n";
+        for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
     }
 
-    // Load the playlist from a file
-    void loadFromFile(const std::string& filename) {
-        std::ifstream inFile(filename); //ifstream	Reads from files
-        if (!inFile) {
-            std::cerr << "Error opening file for reading.\n";        //cerr means "character error (stream)"
-            return;
+    // one line per operation that ran (calls, total, mean and p50/p99/max latency), then the counters;
+    // with buckets, also every non-empty histogram bucket as "bucket <operation> <upper ns> <count>"
+    void writeReport(std::ostream& out, bool buckets) const {
+        auto us = [](std::uint64_t ns) { return double(ns) / 1000.0; };
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(1);
+        out << std::setw(18) << std::left << "OPERATION" << std::setw(10) << std::right << "CALLS"
+            << std::setw(12) << "TOTAL ms" << std::setw(11) << "MEAN us" << std::setw(11) << "P50 us"
+            << std::setw(11) << "P99 us" << std::setw(11) << "MAX us" << '\n';
+        for (std::size_t i = 0; i < kOperations; ++i) {
+            const Histogram& h = histograms[i];
+            std::uint64_t calls = h.count.load(std::memory_order_relaxed);
+            if (calls == 0) continue;
+            std::uint64_t total = h.totalNs.load(std::memory_order_relaxed);
+            out << std::setw(18) << std::left << nameOf(Operation(i)) << std::setw(10) << std::right << calls
+                << std::setw(12) << double(total) / 1e6 << std::setw(11) << us(total / calls)
+                << std::setw(11) << us(percentileNs(h, 0.5)) << std::setw(11) << us(percentileNs(h, 0.99))
+                << std::setw(11) << us(h.maxNs.load(std::memory_order_relaxed)) << '\n';
         }
-        songs.clear();  // Clear the existing playlist
-        std::string line;
-        while (std::getline(inFile, line)) {
-            if (!line.empty()) {  
-                Song song = Song::fromString(line);
-                addSong(song);// Add the song to the playlist
-            }
+        for (std::size_t i = 0; i < kCounters; ++i)
+            out << nameOf(Counter(i)) << ": " << counters[i].load(std::memory_order_relaxed) << '\n';
+        if (buckets) {
+            for (std::size_t i = 0; i < kOperations; ++i)
+                for (int b = 0; b < kBuckets; ++b) {
+                    std::uint64_t n = histograms[i].buckets[b].load(std::memory_order_relaxed);
+                    if (n > 0) out << "bucket " << nameOf(Operation(i)) << ' ' << (b == 0 ? 0 : std::uint64_t(1) << b) << ' ' << n << '\n';
+                }
         }
-        inFile.close();
-        std::cout << "Playlist loaded from " << filename << "\n"; 
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    // write the report with its buckets to a file, returns false if it cannot be written
+    bool dumpToFile(const std::string& filename) const {
+        std::ofstream out(filename);
+        if (!out) return false;
+        writeReport(out, true);
+        return bool(out.flush());
     }
 };
 
-// UndoStack class managing undo and redo operations
-class UndoStack {
+OperationStats operationStats;
+
+// times one operation from construction to the end of the scope, only while stats are on
+class OperationTimer {
 private:
-    Playlist& playlist;  //refrence to the playlist to modify it during undo/redo
-    std::stack<UndoAction> undoStack;// stack to store actions for undo
-    std::stack<UndoAction> redoStack;// stack to store actions for redo
+    Operation op;
+    bool timing;
+    std::chrono::steady_clock::time_point start;
 
 public:
-    // Constructor that takes playlist by reference to modify it
-    UndoStack(Playlist& p) : playlist(p) {}
-
-    // Push an action onto the stack (Add or Remove)
-    void pushAction(const UndoAction& action) {
-        undoStack.push(action);
-        while (!redoStack.empty()) {  // clear the redo stack since a new action has been made and invalidates previous redo history
-            redoStack.pop();
-        }
+    explicit OperationTimer(Operation timed) : op(timed), timing(operationStats.enabled()) {
+        if (timing) start = std::chrono::steady_clock::now();
     }
+    ~OperationTimer() {
+        if (timing) operationStats.record(op, std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+};
 
-    // Undo the last action
-    void undoAction() {
-        if (!undoStack.empty()) { 
-            UndoAction lastAction = undoStack.top();
-            undoStack.pop();
+// ---------- Parallel helpers ----------
+// bulk loads, sorts and listings split their input into pieces handled by worker threads and put the
+// results back together in input order, so they give the same result for any number of threads
 
-            // Undo based on the action type
-            if (lastAction.actionType == UndoAction::ActionType::ADD) {
-                playlist.removeSong(lastAction.song.title);
-            }
-            else if (lastAction.actionType == UndoAction::ActionType::REMOVE) {
-                playlist.addSong(lastAction.song);  
-                std::cout << "Restored song: " << lastAction.song.title << "\n";
-            }
+// smallest piece worth a thread of its own
+constexpr std::size_t kParallelMinBytes = 1 << 20; // file bytes
+constexpr std::size_t kParallelMinItems = 1 << 15; // songs
 
-            redoStack.push(lastAction);// push the redone action onto the undo stack to allow undoing it again if needed
-        }
-        else {
-            std::cout << "No actions to undo.\n";
-        }
+// threads for a job: the requested number (0 means one per core), fewer when the input is small
+inline std::size_t threadsFor(std::size_t requested, std::size_t work, std::size_t minPerThread) {
+    std::size_t threads = requested > 0 ? requested : std::max(1u, std::thread::hardware_concurrency());
+    return std::max<std::size_t>(1, std::min(threads, work / minPerThread));
+}
+
+// call fn(part) for every part in [0, parts): part 0 on the calling thread, the others on their own threads
+template <typename Fn>
+void runParallel(std::size_t parts, Fn fn) {
+    std::vector<std::thread> workers;
+    for (std::size_t part = 1; part < parts; ++part) workers.emplace_back(fn, part);
+    if (parts > 0) fn(0);
+    for (std::thread& worker : workers) worker.join();
+}
+
+// split a file buffer into at most this many pieces of about the same size, each ending at a line break
+std::vector<std::string_view> splitAtLines(std::string_view data, std::size_t parts) {
+    std::vector<std::string_view> pieces;
+    while (!data.empty()) {
+        std::size_t end = parts > 1 ? data.size() / parts : data.size();
+        end = end < data.size() ? data.find('\n', end) : std::string_view::npos;
+        end = end == std::string_view::npos ? data.size() : end + 1;
+        pieces.push_back(data.substr(0, end));
+        data.remove_prefix(end);
+        if (parts > 1) --parts;
     }
+    return pieces;
+}
 
-    // Redo the last undone action
-    void redoAction() {
-        if (!redoStack.empty()) {
-            UndoAction lastAction = redoStack.top();
-            redoStack.pop();
+// the song lines of one piece of a file, split and lowercased by a worker thread
+struct ParsedSongs {
+    struct Line {
+        SongFields fields;
+        std::string_view lowerTitle;   // into the file, or into folded when the text has capitals
+        std::string_view lowerArtist;
+    };
+    std::vector<Line> lines;
+    std::string folded;
+    std::size_t skipped = 0;
+};
 
-            // Redo based on the action type
-            if (lastAction.actionType == UndoAction::ActionType::ADD) {
-                playlist.addSong(lastAction.song); 
-            }
-            else if (lastAction.actionType == UndoAction::ActionType::REMOVE) {
-                playlist.removeSong(lastAction.song.title);  
-            }           
-            undoStack.push(lastAction);
-        }
-        else {
-            std::cout << "No actions to redo.\n";
-        }
+// forEachSongLine over pieces of the file on several threads, with the lowercase title and artist
+// worked out there as well; the pieces come back in file order
+std::vector<ParsedSongs> parseSongLinesParallel(std::string_view data, std::size_t threads) {
+    std::vector<std::string_view> pieces = splitAtLines(data, threadsFor(threads, data.size(), kParallelMinBytes));
+    std::vector<ParsedSongs> parsed(pieces.size());
+    runParallel(pieces.size(), [&](std::size_t part) {
+        ParsedSongs& out = parsed[part];
+        out.lines.reserve(std::size_t(std::count(pieces[part].begin(), pieces[part].end(), '\n')) + 1);
+        out.folded.reserve(pieces[part].size()); // never grows, so views into it stay valid
+        auto lower = [&out](std::string_view text) {
+            auto upper = std::find_if(text.begin(), text.end(), [](char c) { return c != ::tolower(static_cast<unsigned char>(c)); });
+            if (upper == text.end()) return text;
+            std::size_t start = out.folded.size();
+            for (char c : text) out.folded += char(::tolower(static_cast<unsigned char>(c)));
+            return std::string_view(out.folded).substr(start);
+        };
+        out.skipped = forEachSongLine(pieces[part], [&](const SongFields& fields) {
+            out.lines.push_back({ fields, lower(fields.title), lower(fields.artist) });
+        });
+    });
+    return parsed;
+}
+
+// stable sort on several threads: each thread sorts one run, then neighbouring runs are merged in
+// rounds; both steps keep equal items in their order, so the result matches std::stable_sort
+template <typename T, typename Less>
+void parallelStableSort(std::vector<T>& items, Less less, std::size_t threads) {
+    std::size_t runs = threadsFor(threads, items.size(), kParallelMinItems);
+    std::vector<std::size_t> bounds(runs + 1);
+    for (std::size_t run = 0; run <= runs; ++run) bounds[run] = items.size() * run / runs;
+    runParallel(runs, [&](std::size_t run) {
+        std::stable_sort(items.begin() + bounds[run], items.begin() + bounds[run + 1], less);
+    });
+    for (std::size_t width = 1; width < runs; width *= 2) {
+        runParallel((runs + 2 * width - 1) / (2 * width), [&](std::size_t merge) {
+            std::size_t first = 2 * width * merge;
+            std::size_t middle = std::min(first + width, runs), last = std::min(first + 2 * width, runs);
+            if (middle < last)
+                std::inplace_merge(items.begin() + bounds[first], items.begin() + bounds[middle], items.begin() + bounds[last], less);
+        });
+    }
+}
+
+// Comparator for priority queue to sort by rating
+struct CompareSongRating {
+    bool operator()(const Song& a, const Song& b) {
+        return a.rating < b.rating;  // higher ratings have higher priority
     }
 };
-// Priority Queue for managing songs sorted by rating
-class SongPriorityQueue {
+
+// id of a song slot in a playlist (slots freed by removes are reused by later adds)
+using SongId = std::uint32_t;
+constexpr SongId kNoSong = 0xFFFFFFFFu; // end of the playlist order / no such song
+
+// id of a string stored in a StringPool
+using StringId = std::uint32_t;
+
+// UndoAction class to store undoable actions: one 8-byte entry of the undo log, naming the song by its id
+struct UndoAction { //-https://www.w3schools.com/cpp/cpp_enum.asp
+
+   enum class ActionType : std::uint8_t { ADD, REMOVE, SORT, SORT_ARTIST_TITLE }; // enum class to define the type of action being tracked
+    SongId song;          // the song added or removed (unused for sorts)
+    ActionType actionType;
+    bool startsGroup;     // first action of a group that is undone and redone as one step
+
+    UndoAction() : song(kNoSong), actionType(ActionType::ADD), startsGroup(false) {}
+    UndoAction(ActionType action, SongId id, bool first) : song(id), actionType(action), startsGroup(first) {}
+
+    bool isSort() const { return actionType == ActionType::SORT || actionType == ActionType::SORT_ARTIST_TITLE; }
+};
+
+// Double-ended queue kept in one ring of slots: pushing at the back and popping at either end reuse the
+// same storage, unlike std::deque, which allocates and frees a block every few hundred elements as it
+// slides; the ring only grows (doubling) when it is full
+template <typename T>
+class RingBuffer {
 private:
-   
-            // The priority queue to store songs, sorted by rating.
-    std::priority_queue<Song, std::vector<Song>, CompareSongRating> songQueue;
-    //helper tomlower ffunction for the case sensitive
-    std::string toLowerCase(const std::string& str) const {
-        std::string lowerStr = str;
-        std::transform(lowerStr.begin(), lowerStr.end(), lowerStr.begin(), ::tolower);
-        return lowerStr;
+    std::vector<T> items;    // capacity is zero or a power of two
+    std::size_t head = 0;    // position of the first element
+    std::size_t count = 0;
+
+    std::size_t at(std::size_t i) const { return (head + i) & (items.size() - 1); }
+
+    void grow() {
+        std::vector<T> larger(std::max<std::size_t>(16, 2 * items.size()));
+        for (std::size_t i = 0; i < count; ++i) larger[i] = std::move(items[at(i)]);
+        items.swap(larger);
+        head = 0;
     }
-   
 
-    
 public:
-   
-    //  function to save a song to the text file
-    void saveSongToFile(const Song& song) {
-        std::ofstream outFile("songs.txt", std::ios::app); 
-        if (!outFile) {
-            std::cerr << "Error opening file for writing.\n";
-            return;
-        }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    std::size_t capacity() const { return items.size(); }
 
-        outFile << song.toString() << "\n"; 
-        outFile.close();
-        std::cout << "Song saved to 'songs.txt'.\n";
-    }
-    void loadFromFile(const std::string& filename) {
-        std::ifstream inFile(filename); 
-        if (!inFile) {
-            std::cerr << "Error opening file for reading.\n";       
-            return;
-        }
-       
-        std::string line;
-        while (std::getline(inFile, line)) {
-            if (!line.empty()) { 
-                Song song = Song::fromString(line);
-                addSong(song);// Add the song to the song priority playlist
-            }
-        }
-        inFile.close();
-        std::cout << "Playlist loaded from " << filename << "\n"; 
+    T& operator[](std::size_t i) { return items[at(i)]; }
+    const T& operator[](std::size_t i) const { return items[at(i)]; }
+    T& front() { return items[head]; }
+    T& back() { return items[at(count - 1)]; }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (count == items.size()) grow();
+        T& slot = items[at(count)];
+        slot = T(std::forward<Args>(args)...);
+        ++count;
+        return slot;
     }
-   
-    //Function to Add Song to the priorityqueue
-    void addSong(const Song& song) {
-          songQueue.push(song);
+
+    void pop_front() {
+        head = at(1);
+        --count;
     }
-    
-    // function to display the top songs in the priority queue
-    void displayTopSongs() const {
-        if (songQueue.empty()) { 
-            std::cout << "No songs in the priority queue.\n";
-            return; // exit the function
-        }
 
-        std::cout << "********** Top rated songs in priority queue **********\n";
-        std::cout << std::setw(35) << std::left << "TITLE"
-            << std::setw(20) << std::left << "ARTIST"
-            << std::setw(10) << std::right << "RATING\n";
-        std::cout << std::setfill('-') << std::setw(65) << "" << std::setfill(' ') << '\n';  
-            std::priority_queue<Song, std::vector<Song>, CompareSongRating> tempQueue = songQueue;
-            while (!tempQueue.empty()) {
-                const Song& s= tempQueue.top(); 
-                    // print the song title, artist, and rating to the console
-                    std::cout << std::setw(35) << std::left << s.title  
-                        << std::setw(20) << std::left << s.artist
-                        << std::setw(5) << std::right << "[ " << s.rating << "/5 ] \n";
-                    tempQueue.pop();// remove the song from the temporary queue
-            }
-          
+    void pop_back() { --count; }
+
+    void clear() {
+        head = 0;
+        count = 0;
     }
 };
 
-
-// Main application class
-class MusicPlaylistManager {
+// Open-addressing hash map from a string_view to a 32-bit value (linear probing, backward-shift erase)
+// the map does not own the text: keys must stay alive while they are in the map, which holds for
+// strings stored in a StringPool; used where unordered_map's one allocation per entry dominates
+class FlatStringMap {
 private:
-    Playlist playlist;
-    UndoStack undoStack;
-    SongPriorityQueue priorityQueue;
-    std::string getCurrentTime() { //-https://www.w3schools.com/cpp/ref_ctime_asctime.asp
-                                   //-https://www.w3schools.com/cpp/cpp_date.asp
-        // Get current time from system clock
-        auto now = std::chrono::system_clock::now();
-        std::time_t time = std::chrono::system_clock::to_time_t(now);
+    static constexpr std::uint32_t kEmpty = 0xFFFFFFFFu; // size of an unused entry
+    struct Entry {
+        const char* data = nullptr;
+        std::uint32_t size = kEmpty;
+        std::uint32_t hash = 0;
+        std::uint32_t value = 0;
+    };
+    std::vector<Entry> table;  // capacity is a power of two, kept at most half full
+    std::size_t count = 0;
 
-        // Convert to a readable format using std::localtime_r or std::localtime_s for thread safety
-        std::tm localTime;
-        #ifdef _WIN32
-                localtime_s(&localTime, &time);  // Use localtime_s on Windows
-        #else
-                localtime_r(&time, &localTime);  // Use localtime_r on POSIX systems
-        #endif
+    static std::uint32_t hashOf(std::string_view key) {
+        std::uint64_t h = 14695981039346656037ull; // FNV-1a
+        for (char c : key) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        return std::uint32_t(h ^ (h >> 32));
+    }
 
-        // Format the time (e.g., "YYYY-MM-DD HH:MM:SS")
-        std::stringstream timeStream;
-        timeStream << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S");
+    // the hash of the key's lowercase form, without building it
+    static std::uint32_t foldedHashOf(std::string_view key) {
+        std::uint64_t h = 14695981039346656037ull;
+        for (char c : key) h = (h ^ static_cast<unsigned char>(::tolower(static_cast<unsigned char>(c)))) * 1099511628211ull;
+        return std::uint32_t(h ^ (h >> 32));
+    }
 
-        return timeStream.str();
+    std::size_t mask() const { return table.size() - 1; }
+
+    // entry holding the key, or the empty entry where it would go
+    std::size_t probe(std::string_view key, std::uint32_t hash) const {
+        std::size_t pos = hash & mask();
+        while (table[pos].size != kEmpty) {
+            const Entry& e = table[pos];
+            if (e.hash == hash && e.size == key.size() && std::memcmp(e.data, key.data(), key.size()) == 0) break;
+            pos = (pos + 1) & mask();
+        }
+        return pos;
     }
-    
+
+    void grow(std::size_t capacity) {
+        std::vector<Entry> old;
+        old.swap(table);
+        table.assign(capacity, Entry());
+        for (const Entry& e : old) {
+            if (e.size == kEmpty) continue;
+            std::size_t pos = e.hash & mask();
+            while (table[pos].size != kEmpty) pos = (pos + 1) & mask();
+            table[pos] = e;
+        }
+    }
+
 public:
-    MusicPlaylistManager() : undoStack(playlist) {}
-    // Display the current time
-    void print_time() {
-        std::cout << std::setfill('*') << std::setw(20) << "" << std::setfill(' ');
-        std::cout << getCurrentTime(); 
-        std::cout << std::setfill('*') << std::setw(21) << "" << std::setfill(' ');
+    FlatStringMap() { table.assign(16, Entry()); }
+
+    std::size_t size() const { return count; }
+
+    // room for this many keys without rehashing
+    void reserve(std::size_t keys) {
+        std::size_t capacity = table.size();
+        while (capacity < 2 * keys) capacity *= 2;
+        if (capacity > table.size()) grow(capacity);
     }
-    //function to run the Main application
-    void run() {
+
+    // value stored for the key, or nullptr
+    const std::uint32_t* find(std::string_view key) const {
+        std::size_t pos = probe(key, hashOf(key));
+        return table[pos].size == kEmpty ? nullptr : &table[pos].value;
+    }
+
+    std::uint32_t* find(std::string_view key) {
+        std::size_t pos = probe(key, hashOf(key));
+        return table[pos].size == kEmpty ? nullptr : &table[pos].value;
+    }
+
+    // value stored for the lowercase form of the text, or nullptr; for maps whose keys are all
+    // lowercase, so a lookup ignoring case needs no lowercase copy of the text
+    const std::uint32_t* findFolded(std::string_view text) const {
+        std::uint32_t hash = foldedHashOf(text);
+        for (std::size_t pos = hash & mask(); table[pos].size != kEmpty; pos = (pos + 1) & mask()) {
+            const Entry& e = table[pos];
+            if (e.hash == hash && e.size == text.size()
+                && std::equal(text.begin(), text.end(), e.data,
+                    [](char a, char b) { return ::tolower(static_cast<unsigned char>(a)) == b; })) return &e.value;
+        }
+        return nullptr;
+    }
+
+    // make the entry of a key refer to another copy of the same text, before the copy it uses goes away
+    void moveKey(std::string_view key, std::string_view copy) {
+        std::size_t pos = probe(key, hashOf(key));
+        if (table[pos].size != kEmpty) table[pos].data = copy.data();
+    }
+
+    // store the key with a value unless it is already there; returns the stored value and whether it was added
+    std::pair<std::uint32_t*, bool> insert(std::string_view key, std::uint32_t value) {
+        if (2 * (count + 1) > table.size()) grow(2 * table.size());
+        std::uint32_t hash = hashOf(key);
+        std::size_t pos = probe(key, hash);
+        if (table[pos].size != kEmpty) return { &table[pos].value, false };
+        table[pos] = Entry{ key.data(), std::uint32_t(key.size()), hash, value };
+        ++count;
+        return { &table[pos].value, true };
+    }
+
+    // remove the key, shifting later entries of its probe run back so lookups never hit a hole
+    void erase(std::string_view key) {
+        std::size_t pos = probe(key, hashOf(key));
+        if (table[pos].size == kEmpty) return;
+        std::size_t next = (pos + 1) & mask();
+        while (table[next].size != kEmpty) {
+            std::size_t home = table[next].hash & mask();
+            // move the entry back if its home is not between the hole and where it sits now
+            if (((next - home) & mask()) >= ((next - pos) & mask())) {
+                table[pos] = table[next];
+                pos = next;
+            }
+            next = (next + 1) & mask();
+        }
+        table[pos] = Entry();
+        --count;
+    }
+
+    void clear() {
+        table.assign(16, Entry());
+        count = 0;
+    }
+
+    // bytes held by the table
+    std::size_t memoryUsage() const { return table.capacity() * sizeof(Entry); }
+};
+
+// Arena-backed string pool: strings are copied into large shared blocks and referred to by a 4-byte id;
+// interned strings are stored once, so repeated artists like "Dionela" or "Arthur Nery" cost nothing extra
+// (strings stay in the pool until clear(); a released one only lends its bytes to a new string of its size)
+class StringPool {
+private:
+    static constexpr std::size_t kBlockSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks;        // the arena, blocks never move once allocated
+    std::size_t blockUsed = kBlockSize;                 // bytes taken in the last block
+    std::size_t arenaBytes = 0;                         // total bytes allocated for blocks
+    std::vector<std::string_view> strings;              // id -> text inside the arena
+    FlatStringMap ids;                                  // interned text -> id
+    static constexpr std::size_t kMaxRecycledSize = 256;
+    std::vector<std::vector<StringId>> releasedBySize;  // size -> released strings of that size
+
+    // copy text into the arena and return where it lives
+    std::string_view store(std::string_view text) {
+        if (text.size() > kBlockSize) { // oversized strings get a block of their own
+            blocks.emplace_back(new char[text.size()]);
+            arenaBytes += text.size();
+            std::memcpy(blocks.back().get(), text.data(), text.size());
+            std::string_view stored(blocks.back().get(), text.size());
+            blockUsed = kBlockSize; // start a fresh block for the next small string
+            return stored;
+        }
+        if (blockUsed + text.size() > kBlockSize) {
+            blocks.emplace_back(new char[kBlockSize]);
+            arenaBytes += kBlockSize;
+            blockUsed = 0;
+        }
+        char* dest = blocks.back().get() + blockUsed;
+        if (!text.empty()) std::memcpy(dest, text.data(), text.size());
+        blockUsed += text.size();
+        return std::string_view(dest, text.size());
+    }
+
+public:
+    // store a copy of the text under a new id (for mostly unique strings such as titles)
+    StringId add(std::string_view text) {
+        if (text.size() < releasedBySize.size() && !releasedBySize[text.size()].empty()) {
+            StringId id = releasedBySize[text.size()].back();
+            releasedBySize[text.size()].pop_back();
+            std::memcpy(const_cast<char*>(strings[id].data()), text.data(), text.size()); // the arena is not const
+            return id;
+        }
+        strings.push_back(store(text));
+        return StringId(strings.size() - 1);
+    }
+
+    // id of the text, storing it only the first time it is seen (for repeated strings such as artists)
+    StringId intern(std::string_view text) {
+        if (const StringId* found = ids.find(text)) return *found;
+        StringId id = add(text);
+        ids.insert(strings[id], id);
+        return id;
+    }
+
+    std::string_view view(StringId id) const { return strings[id]; }
+
+    // give back a string nothing refers to any more (never an interned one): add() reuses its id and
+    // bytes for the next text of the same size, so removing and adding songs stops growing the arena
+    void release(StringId id) {
+        std::size_t size = strings[id].size();
+        if (size == 0 || size > kMaxRecycledSize) return; // longer ones are rare, their bytes stay unused
+        if (releasedBySize.empty()) releasedBySize.resize(kMaxRecycledSize + 1);
+        releasedBySize[size].push_back(id);
+    }
+
+    void reserve(std::size_t count) { strings.reserve(count); }
+
+    // bytes held by the arena and the lookup table
+    std::size_t memoryUsage() const {
+        return arenaBytes + strings.capacity() * sizeof(std::string_view) + ids.memoryUsage();
+    }
+
+    void clear() {
+        blocks.clear();
+        blockUsed = kBlockSize;
+        arenaBytes = 0;
+        strings.clear();
+        ids.clear();
+        releasedBySize.clear();
+    }
+};
+
+// Trigram inverted index for case-insensitive substring search
+// every 1-, 2- and 3-character window of the lowercase text points to the sorted ids that contain it,
+// so a query only verifies songs that share all of its trigrams instead of scanning everything
+// (queries shorter than 3 characters are answered straight from their own posting list)
+class TrigramIndex {
+private:
+    // 1- and 2-character grams are few enough for a direct table, trigrams go in a hash map
+    std::vector<std::vector<SongId>> shortPostings = std::vector<std::vector<SongId>>(256 + 65536);
+    std::unordered_map<std::uint32_t, std::vector<SongId>> postings; // trigram -> ids containing it (ascending)
+    std::vector<std::uint32_t> gramBuffer;                           // reused by add/remove
+
+    // pack up to 3 characters and their count into one key
+    static std::uint32_t gramAt(std::string_view str, std::size_t pos, std::size_t len) {
+        std::uint32_t key = std::uint32_t(len) << 24;
+        for (std::size_t i = 0; i < len; ++i)
+            key |= std::uint32_t(static_cast<unsigned char>(str[pos + i])) << (8 * (2 - i));
+        return key;
+    }
+
+    // distinct grams of a string, of every length from minLen to 3
+    static void gramsOf(std::string_view str, std::size_t minLen, std::vector<std::uint32_t>& grams) {
+        grams.clear();
+        for (std::size_t len = minLen; len <= 3; ++len)
+            for (std::size_t i = 0; i + len <= str.size(); ++i) grams.push_back(gramAt(str, i, len));
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    }
+
+    // slot of a 1- or 2-character gram in the direct table
+    static std::size_t shortSlot(std::uint32_t gram) {
+        return (gram >> 24) == 1 ? (gram >> 16) & 0xFF : 256 + ((gram >> 8) & 0xFFFF);
+    }
+
+    std::vector<SongId>& postingFor(std::uint32_t gram) {
+        return (gram >> 24) < 3 ? shortPostings[shortSlot(gram)] : postings[gram];
+    }
+
+    const std::vector<SongId>* findPosting(std::uint32_t gram) const {
+        if ((gram >> 24) < 3) {
+            const std::vector<SongId>& ids = shortPostings[shortSlot(gram)];
+            return ids.empty() ? nullptr : &ids;
+        }
+        auto posting = postings.find(gram);
+        return posting == postings.end() ? nullptr : &posting->second;
+    }
+
+public:
+    // index a lowercase text under the given id
+    void add(SongId id, std::string_view lowerText) {
+        gramsOf(lowerText, 1, gramBuffer);
+        for (std::uint32_t gram : gramBuffer) {
+            std::vector<SongId>& ids = postingFor(gram);
+            if (ids.empty() || ids.back() < id) ids.push_back(id); // new slots arrive in increasing order
+            else ids.insert(std::lower_bound(ids.begin(), ids.end(), id), id);
+        }
+    }
+
+    // drop every id marked in dead from all posting lists in one pass
+    // (removing ids one by one shifts the long lists of common grams each time)
+    void purge(const std::vector<bool>& dead) {
+        auto isDead = [&dead](SongId id) { return id < dead.size() && dead[id]; };
+        for (std::vector<SongId>& ids : shortPostings)
+            ids.erase(std::remove_if(ids.begin(), ids.end(), isDead), ids.end());
+        for (auto posting = postings.begin(); posting != postings.end();) {
+            std::vector<SongId>& ids = posting->second;
+            ids.erase(std::remove_if(ids.begin(), ids.end(), isDead), ids.end());
+            if (ids.empty()) posting = postings.erase(posting);
+            else ++posting;
+        }
+    }
+
+    void clear() {
+        for (std::vector<SongId>& ids : shortPostings) ids.clear();
+        postings.clear();
+    }
+
+    // expected number of distinct trigrams, to size the hash map before a bulk build
+    void reserve(std::size_t trigrams) { postings.reserve(trigrams); }
+
+    // ids (ascending) whose text contains the non-empty lowercase query
+    // textOf(id) gives back the lowercase text an id was indexed with, to verify candidates
+    template <typename TextOf>
+    std::vector<SongId> search(std::string_view lowerQuery, TextOf textOf) const {
+        std::vector<SongId> result;
+        if (lowerQuery.size() < 3) { // the query is itself a gram, its posting list is the answer
+            const std::vector<SongId>* posting = findPosting(gramAt(lowerQuery, 0, lowerQuery.size()));
+            if (posting) result = *posting;
+            operationStats.count(Counter::SONGS_SCANNED, result.size());
+            return result;
+        }
+
+        // collect the posting list of every query trigram, rarest first
+        std::vector<std::uint32_t> grams;
+        gramsOf(lowerQuery, 3, grams);
+        std::vector<const std::vector<SongId>*> lists;
+        for (std::uint32_t gram : grams) {
+            const std::vector<SongId>* posting = findPosting(gram);
+            if (!posting) return result; // some trigram appears nowhere, so nothing matches
+            lists.push_back(posting);
+        }
+        std::sort(lists.begin(), lists.end(),
+            [](const std::vector<SongId>* a, const std::vector<SongId>* b) { return a->size() < b->size(); });
+
+        // intersect the lists, then confirm the candidates really contain the query
+        std::vector<SongId> candidates = *lists.front();
+        std::vector<SongId> narrowed;
+        for (std::size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+            narrowed.clear();
+            std::set_intersection(candidates.begin(), candidates.end(),
+                lists[i]->begin(), lists[i]->end(), std::back_inserter(narrowed));
+            candidates.swap(narrowed);
+        }
+        operationStats.count(Counter::SONGS_SCANNED, candidates.size());
+        for (SongId id : candidates) {
+            if (textOf(id).find(lowerQuery) != std::string_view::npos) result.push_back(id);
+        }
+        return result;
+    }
+};
+
+// edit distance (insertions, deletions and substitutions) between a and b when it is at most bound,
+// otherwise bound + 1; only the cells within bound of the diagonal are filled, and the rows stop as soon
+// as every one of them is past the bound, so a far-off pair costs little (rows are reused buffers)
+inline std::size_t boundedEditDistance(std::string_view a, std::string_view b, std::size_t bound,
+    std::vector<std::size_t>& previous, std::vector<std::size_t>& current) {
+    std::size_t n = a.size(), m = b.size();
+    std::size_t over = bound + 1;
+    if ((n > m ? n - m : m - n) > bound) return over;
+    previous.assign(m + 2, over);
+    current.assign(m + 2, over);
+    for (std::size_t j = 0; j <= std::min(m, bound); ++j) previous[j] = j;
+    for (std::size_t i = 1; i <= n; ++i) {
+        std::size_t lo = i > bound ? i - bound : 1, hi = std::min(m, i + bound);
+        current[lo - 1] = lo == 1 && i <= bound ? i : over;
+        std::size_t rowMin = current[lo - 1];
+        for (std::size_t j = lo; j <= hi; ++j) {
+            std::size_t cell = std::min({ previous[j - 1] + (a[i - 1] != b[j - 1]), previous[j] + 1, current[j - 1] + 1 });
+            current[j] = std::min(cell, over);
+            rowMin = std::min(rowMin, current[j]);
+        }
+        current[hi + 1] = over; // the next row's band reaches one cell further
+        if (rowMin > bound) return over;
+        std::swap(previous, current);
+    }
+    return previous[m];
+}
+
+// Sorted dictionary of distinct lowercase titles, searched for the titles within a few typos of a query
+// the search runs a Levenshtein automaton (one row of the edit distance table per character) over the
+// titles in order as if they were a trie: a title reuses the rows of the prefix it shares with the one
+// before it, and once a prefix's row is past the bound everywhere, every title starting with that prefix is
+// skipped with a binary search, so only the titles close to the query are looked at beyond a few characters
+// new titles wait in a small unsorted batch, checked one by one, until it is merged in; titles are only
+// added: one that leaves the playlist stays and the owner skips it
+class TitleDictionary {
+private:
+    static constexpr std::size_t kBatchSize = 1024;
+    StringPool strings;
+    std::vector<std::string_view> sorted;
+    std::vector<std::string_view> recent;         // added since the last merge
+
+    void mergeRecent() {
+        std::sort(recent.begin(), recent.end());
+        std::size_t middle = sorted.size();
+        sorted.insert(sorted.end(), recent.begin(), recent.end());
+        std::inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end());
+        recent.clear();
+    }
+
+public:
+    // replace the contents with these distinct titles
+    void build(std::vector<std::string_view> titles) {
+        clear();
+        std::sort(titles.begin(), titles.end());
+        sorted.reserve(titles.size());
+        for (std::string_view title : titles) sorted.push_back(strings.view(strings.add(title)));
+    }
+
+    // add a title unless it is already there
+    void insert(std::string_view title) {
+        if (std::binary_search(sorted.begin(), sorted.end(), title)) return;
+        if (std::find(recent.begin(), recent.end(), title) != recent.end()) return;
+        recent.push_back(strings.view(strings.add(title)));
+        if (recent.size() >= kBatchSize) mergeRecent();
+    }
+
+    // call fn(title, distance) for every title within maxDistance of the lowercase query
+    // the rows are the search's own, so searches may run in several threads
+    template <typename Fn>
+    void search(std::string_view query, std::size_t maxDistance, Fn fn) const {
+        std::vector<std::size_t> previousRow, currentRow; // for the recent titles
+        for (std::string_view title : recent) {
+            std::size_t distance = boundedEditDistance(query, title, maxDistance, previousRow, currentRow);
+            if (distance <= maxDistance) fn(title, distance);
+        }
+        const std::size_t width = query.size() + 1;
+        std::vector<std::size_t> rows(width); // row d: the query against a title's first d characters
+        for (std::size_t j = 0; j < width; ++j) rows[j] = j;
+        std::string_view last;      // the title the rows were worked out for
+        std::size_t depth = 0;      // how many of its characters they cover
+        for (std::size_t i = 0; i < sorted.size();) {
+            std::string_view title = sorted[i];
+            std::size_t d = 0, shared = std::min({ depth, title.size(), last.size() });
+            while (d < shared && title[d] == last[d]) ++d;
+            if (rows.size() < (title.size() + 1) * width) rows.resize((title.size() + 1) * width);
+            bool pruned = false;
+            while (d < title.size() && !pruned) {
+                const std::size_t* above = &rows[d * width];
+                std::size_t* row = &rows[(d + 1) * width];
+                row[0] = d + 1;
+                std::size_t rowMin = row[0];
+                for (std::size_t j = 1; j < width; ++j) {
+                    row[j] = std::min({ above[j] + 1, row[j - 1] + 1, above[j - 1] + (query[j - 1] != title[d]) });
+                    rowMin = std::min(rowMin, row[j]);
+                }
+                ++d;
+                pruned = rowMin > maxDistance;
+            }
+            last = title;
+            depth = d;
+            if (!pruned) {
+                if (rows[d * width + width - 1] <= maxDistance) fn(title, rows[d * width + width - 1]);
+                ++i;
+                continue;
+            }
+            // no title starting with these d characters can come within the bound
+            std::string_view prefix = title.substr(0, d);
+            i = std::size_t(std::partition_point(sorted.begin() + i + 1, sorted.end(),
+                [prefix](std::string_view other) { return other.substr(0, prefix.size()) == prefix; }) - sorted.begin());
+        }
+    }
+
+    // titles held, including the ones no song has any more
+    std::size_t size() const { return sorted.size() + recent.size(); }
+
+    void clear() {
+        strings.clear();
+        sorted.clear();
+        recent.clear();
+    }
+
+    // bytes held by the lists and their text
+    std::size_t memoryUsage() const {
+        return (sorted.capacity() + recent.capacity()) * sizeof(std::string_view) + strings.memoryUsage();
+    }
+};
+
+// Binary playlist format: a playlist file that can be memory-mapped and read in place, with no text parsing:
+//
+//   header        BinaryPlaylistHeader (64 bytes)
+//   string index  stringCount + 1 uint64 offsets into the string data (string i is [off[i], off[i+1]))
+//   string data   the title and artist bytes, artists stored once
+//   title column  songCount uint32 string numbers
+//   artist column songCount uint32 string numbers
+//   rating column songCount int32 ratings
+//
+// every section starts on an 8-byte boundary and numbers are little-endian (the byte order of x86/x64)
+struct BinaryPlaylistHeader {
+    char magic[4];                 // "MPLB"
+    std::uint32_t version;         // kBinaryPlaylistVersion
+    std::uint64_t songCount;
+    std::uint64_t stringCount;
+    std::uint64_t stringIndexPos;  // file offsets of the sections
+    std::uint64_t stringDataPos;
+    std::uint64_t titleColumnPos;
+    std::uint64_t artistColumnPos;
+    std::uint64_t ratingColumnPos;
+};
+constexpr std::uint32_t kBinaryPlaylistVersion = 1;
+
+// collects songs and writes them in the binary playlist format
+class BinaryPlaylistWriter {
+private:
+    std::vector<std::uint64_t> stringIndex = std::vector<std::uint64_t>(1, 0);
+    std::string stringData;
+    std::vector<std::uint32_t> titleColumn;
+    std::vector<std::uint32_t> artistColumn;
+    std::vector<std::int32_t> ratingColumn;
+    StringPool artistPool;                       // each distinct artist once
+    std::vector<std::uint32_t> artistNumbers;    // artist pool id -> its string number
+
+    std::uint32_t addString(std::string_view text) {
+        stringData.append(text.data(), text.size());
+        stringIndex.push_back(stringData.size());
+        return std::uint32_t(stringIndex.size() - 2);
+    }
+
+    // zero bytes up to the next 8-byte boundary
+    static void pad(std::ofstream& out, std::uint64_t& pos) {
+        static const char zeros[8] = {};
+        std::uint64_t padding = (8 - pos % 8) % 8;
+        out.write(zeros, std::streamsize(padding));
+        pos += padding;
+    }
+
+    template <typename T>
+    static void writeColumn(std::ofstream& out, const std::vector<T>& column, std::uint64_t& pos) {
+        out.write(reinterpret_cast<const char*>(column.data()), std::streamsize(column.size() * sizeof(T)));
+        pos += column.size() * sizeof(T);
+    }
+
+public:
+    void reserve(std::size_t songs) {
+        titleColumn.reserve(songs);
+        artistColumn.reserve(songs);
+        ratingColumn.reserve(songs);
+        stringIndex.reserve(songs + 1);
+    }
+
+    void add(std::string_view title, std::string_view artist, int rating) {
+        titleColumn.push_back(addString(title));
+        StringId artistId = artistPool.intern(artist);
+        if (artistId == artistNumbers.size()) artistNumbers.push_back(addString(artist)); // first time this artist is seen
+        artistColumn.push_back(artistNumbers[artistId]);
+        ratingColumn.push_back(std::int32_t(rating));
+    }
+
+    std::size_t size() const { return titleColumn.size(); }
+
+    // write the file, returns the number of bytes written or 0 on error
+    std::uint64_t write(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out) return 0;
+        BinaryPlaylistHeader header = {};
+        std::memcpy(header.magic, "MPLB", 4);
+        header.version = kBinaryPlaylistVersion;
+        header.songCount = titleColumn.size();
+        header.stringCount = stringIndex.size() - 1;
+
+        // lay the sections out first, then write them in order
+        std::uint64_t pos = sizeof(header);
+        auto align = [](std::uint64_t at) { return (at + 7) / 8 * 8; };
+        header.stringIndexPos = pos;
+        header.stringDataPos = pos = align(pos + stringIndex.size() * sizeof(std::uint64_t));
+        header.titleColumnPos = pos = align(pos + stringData.size());
+        header.artistColumnPos = pos = align(pos + titleColumn.size() * sizeof(std::uint32_t));
+        header.ratingColumnPos = align(pos + artistColumn.size() * sizeof(std::uint32_t));
+
+        pos = 0;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pos += sizeof(header);
+        writeColumn(out, stringIndex, pos);
+        pad(out, pos);
+        out.write(stringData.data(), std::streamsize(stringData.size()));
+        pos += stringData.size();
+        pad(out, pos);
+        writeColumn(out, titleColumn, pos);
+        pad(out, pos);
+        writeColumn(out, artistColumn, pos);
+        pad(out, pos);
+        writeColumn(out, ratingColumn, pos);
+        return out ? pos : 0;
+    }
+};
+
+// read-only view of a binary playlist file: the file is mapped and songs are read straight from it
+class BinaryPlaylistView {
+private:
+    MappedFile file;
+    BinaryPlaylistHeader header = {};
+    bool valid = false;
+
+    template <typename T>
+    T readAt(std::uint64_t pos) const {
+        T value;
+        std::memcpy(&value, file.data().data() + pos, sizeof(T)); // the mapping gives no alignment guarantee
+        return value;
+    }
+
+    std::uint32_t columnAt(std::uint64_t columnPos, std::size_t i) const {
+        return readAt<std::uint32_t>(columnPos + i * sizeof(std::uint32_t));
+    }
+
+public:
+    explicit BinaryPlaylistView(const std::string& filename) : file(filename) {
+        std::string_view data = file.data();
+        if (!file.isOpen() || data.size() < sizeof(header)) return;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.magic, "MPLB", 4) != 0 || header.version != kBinaryPlaylistVersion) return;
+        // every section has to fit in the file, in the documented order
+        std::uint64_t songs = header.songCount, bytes = data.size();
+        // counts and positions no larger than the file rule out overflow in the sums below
+        valid = songs <= bytes && header.stringCount < bytes
+            && header.stringIndexPos <= bytes && header.stringDataPos <= bytes && header.titleColumnPos <= bytes
+            && header.artistColumnPos <= bytes && header.ratingColumnPos <= bytes
+            && header.stringIndexPos >= sizeof(header)
+            && header.stringDataPos >= header.stringIndexPos + (header.stringCount + 1) * sizeof(std::uint64_t)
+            && header.titleColumnPos >= header.stringDataPos
+            && header.artistColumnPos >= header.titleColumnPos + songs * sizeof(std::uint32_t)
+            && header.ratingColumnPos >= header.artistColumnPos + songs * sizeof(std::uint32_t)
+            && data.size() >= header.ratingColumnPos + songs * sizeof(std::int32_t);
+    }
+
+    bool isValid() const { return valid; }
+    std::size_t size() const { return valid ? std::size_t(header.songCount) : 0; }
+    std::size_t fileBytes() const { return file.data().size(); }
+    std::size_t stringCount() const { return valid ? std::size_t(header.stringCount) : 0; }
+
+    // text of a string number, empty if the number or its offsets are out of range
+    std::string_view text(std::uint32_t number) const {
+        if (!valid || number >= header.stringCount) return std::string_view();
+        std::uint64_t begin = readAt<std::uint64_t>(header.stringIndexPos + number * sizeof(std::uint64_t));
+        std::uint64_t end = readAt<std::uint64_t>(header.stringIndexPos + (number + 1) * sizeof(std::uint64_t));
+        // offsets come from the file, so they are compared with the data size rather than added to its position
+        if (begin > end || end > header.titleColumnPos - header.stringDataPos) return std::string_view(); // damaged entry
+        return file.data().substr(std::size_t(header.stringDataPos + begin), std::size_t(end - begin));
+    }
+
+    // string numbers of a song's title and artist
+    std::uint32_t titleNumber(std::size_t i) const { return columnAt(header.titleColumnPos, i); }
+    std::uint32_t artistNumber(std::size_t i) const { return columnAt(header.artistColumnPos, i); }
+
+    std::string_view title(std::size_t i) const { return text(titleNumber(i)); }
+    std::string_view artist(std::size_t i) const { return text(artistNumber(i)); }
+    int rating(std::size_t i) const {
+        return readAt<std::int32_t>(header.ratingColumnPos + i * sizeof(std::int32_t));
+    }
+};
+
+// convert a text playlist ("title,artist,rating" lines) to the binary format, returns false on error
+bool convertTextToBinary(const std::string& textFile, const std::string& binaryFile) {
+    MappedFile file(textFile);
+    if (!file.isOpen()) {
+        std::cerr << "Error opening file for reading.\n";
+        return false;
+    }
+    BinaryPlaylistWriter writer;
+    std::string_view data = file.data();
+    writer.reserve(std::size_t(std::count(data.begin(), data.end(), '\n')) + 1);
+    std::size_t skipped = forEachSongLine(data, [&](const SongFields& fields) {
+        writer.add(fields.title, fields.artist, fields.rating);
+    });
+    if (writer.write(binaryFile) == 0) {
+        std::cerr << "Error opening file for writing.\n";
+        return false;
+    }
+    std::cout << "Converted " << writer.size() << " songs from " << textFile << " to " << binaryFile;
+    if (skipped > 0) std::cout << " (" << skipped << " unreadable lines skipped)";
+    std::cout << "\n";
+    return true;
+}
+
+// convert a binary playlist back to text lines, returns false on error
+bool convertBinaryToText(const std::string& binaryFile, const std::string& textFile) {
+    BinaryPlaylistView view(binaryFile);
+    if (!view.isValid()) {
+        std::cerr << "Error: " << binaryFile << " is not a binary playlist.\n";
+        return false;
+    }
+    std::ofstream outFile(textFile);
+    if (!outFile) {
+        std::cerr << "Error opening file for writing.\n";
+        return false;
+    }
+    for (std::size_t i = 0; i < view.size(); ++i)
+        outFile << view.title(i) << ',' << view.artist(i) << ',' << view.rating(i) << "\n";
+    std::cout << "Converted " << view.size() << " songs from " << binaryFile << " to " << textFile << "\n";
+    return true;
+}
+
+// ---------- Streaming filter ----------
+// "--filter <in> <out> [options]" writes the songs of a playlist file that meet every given condition to a
+// new text file without loading the playlist: text input is read one block at a time and binary input is
+// read in place, so memory stays the same however large the library is
+//   --min-rating N  --max-rating N  --artist <text>  --title <text>   (text is found anywhere, ignoring case)
+//   --top K   keep only the K best-rated matches, best first and in file order within a rating
+
+// forEachSongLine over a stream read one block at a time, for files too large to load
+template <typename Fn>
+std::size_t forEachSongLineStreamed(std::istream& in, Fn fn) {
+    std::string block(1 << 20, '\0');
+    std::size_t carried = 0; // start of a line that continues in the next block
+    std::size_t skipped = 0;
+    while (in) {
+        if (carried == block.size()) block.resize(2 * block.size()); // a line longer than a block
+        in.read(&block[carried], std::streamsize(block.size() - carried));
+        std::size_t filled = carried + std::size_t(in.gcount());
+        std::string_view data(block.data(), filled);
+        std::size_t complete = in ? data.rfind('\n') + 1 : filled; // the last line of the file needs no newline
+        skipped += forEachSongLine(data.substr(0, complete), fn);
+        carried = filled - complete;
+        std::memmove(&block[0], block.data() + complete, carried);
+    }
+    return skipped;
+}
+
+// conditions a song must meet to be exported
+struct SongFilter {
+    int minRating = kMinRating;
+    int maxRating = kMaxRating;
+    std::string artist; // lowercase text the artist must contain, empty for any artist
+    std::string title;  // lowercase text the title must contain, empty for any title
+
+    bool matches(const SongFields& song) const {
+        return song.rating >= minRating && song.rating <= maxRating
+            && containsIgnoreCase(song.artist, artist) && containsIgnoreCase(song.title, title);
+    }
+};
+
+// call fn(fields) for every song of a text or binary (".mplb") playlist file, adding the unreadable lines
+// to skipped; returns false (with a message) when the file cannot be read
+template <typename Fn>
+bool forEachSongInFile(const std::string& inFile, Fn fn, std::size_t& skipped) {
+    if (inFile.size() > 5 && inFile.compare(inFile.size() - 5, 5, ".mplb") == 0) {
+        BinaryPlaylistView view(inFile);
+        if (!view.isValid()) {
+            std::cerr << "Error: " << inFile << " is not a binary playlist.\n";
+            return false;
+        }
+        for (std::size_t i = 0; i < view.size(); ++i) {
+            SongFields song;
+            song.title = view.title(i);
+            song.artist = view.artist(i);
+            song.rating = view.rating(i);
+            fn(song);
+        }
+        return true;
+    }
+    std::ifstream in(inFile, std::ios::binary);
+    if (!in) {
+        std::cerr << "Error opening " << inFile << " for reading.\n";
+        return false;
+    }
+    skipped += forEachSongLineStreamed(in, fn);
+    return true;
+}
+
+// write the songs of inFile that pass the filter to outFile (all of them in file order, or the topK
+// best-rated when topK > 0); only the kept top songs are held in memory
+// the output is written to a temporary file and moved into place, so it may also be the input
+bool streamFilterFile(const std::string& inFile, const std::string& outFile, const SongFilter& filter, std::size_t topK) {
+    auto start = std::chrono::steady_clock::now();
+    std::string temporary = outFile + ".tmp";
+    std::ofstream out(temporary, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error opening file for writing.\n";
+        return false;
+    }
+    std::string buffer;  // output is written in large blocks
+    std::size_t read = 0, matched = 0;
+    auto append = [](std::string& to, const SongFields& song) {
+        to.append(song.title.data(), song.title.size());
+        to += ',';
+        to.append(song.artist.data(), song.artist.size());
+        to += ',';
+        to += std::to_string(song.rating);
+        to += '\n';
+    };
+
+    // bounded top K: a heap with the worst kept song on top, replaced whenever a better one comes by
+    struct Kept {
+        int rating;
+        std::size_t number; // position in the file, breaks rating ties
+        std::string line;
+    };
+    auto better = [](const Kept& a, const Kept& b) { return a.rating != b.rating ? a.rating > b.rating : a.number < b.number; };
+    std::vector<Kept> kept;
+    kept.reserve(std::min<std::size_t>(topK, 1 << 20));
+
+    auto take = [&](const SongFields& song) {
+        ++read;
+        if (!filter.matches(song)) return;
+        ++matched;
+        if (topK == 0) {
+            append(buffer, song);
+            if (buffer.size() >= (1 << 20)) {
+                out.write(buffer.data(), std::streamsize(buffer.size()));
+                buffer.clear();
+            }
+            return;
+        }
+        Kept candidate{ song.rating, read, std::string() };
+        if (kept.size() == topK) {
+            if (!better(candidate, kept.front())) return;
+            std::pop_heap(kept.begin(), kept.end(), better);
+            kept.back().rating = candidate.rating;
+            kept.back().number = candidate.number;
+            kept.back().line.clear(); // reuses the evicted song's string
+        }
+        else kept.push_back(std::move(candidate));
+        append(kept.back().line, song);
+        std::push_heap(kept.begin(), kept.end(), better);
+    };
+
+    std::size_t skipped = 0;
+    if (!forEachSongInFile(inFile, take, skipped)) {
+        out.close();
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    std::sort_heap(kept.begin(), kept.end(), better); // best first
+    for (const Kept& song : kept) buffer += song.line;
+    out.write(buffer.data(), std::streamsize(buffer.size()));
+    out.close();
+    if (!out || !replaceFile(temporary, outFile)) {
+        std::cerr << "Error writing " << outFile << ".\n";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::cout << "Filtered " << read << " songs from " << inFile << ": " << matched << " matched, "
+        << (topK > 0 ? kept.size() : matched) << " written to " << outFile;
+    if (skipped > 0) std::cout << ", " << skipped << " unreadable lines skipped";
+    std::cout << " (" << elapsedMs(start) << " ms)\n";
+    return true;
+}
+
+// read the options that follow "--filter <in> <out>", returns false (with a message) on a bad one
+bool parseFilterOptions(int argc, char* argv[], int first, SongFilter& filter, std::size_t& topK) {
+    for (int i = first; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << "\n";
+            return false;
+        }
+        std::string value = argv[i + 1];
+        auto number = [&value](auto& target) {
+            auto parsed = std::from_chars(value.data(), value.data() + value.size(), target);
+            return parsed.ec == std::errc() && parsed.ptr == value.data() + value.size();
+        };
+        bool valid = true;
+        if (option == "--min-rating") valid = number(filter.minRating);
+        else if (option == "--max-rating") valid = number(filter.maxRating);
+        else if (option == "--top") valid = number(topK);
+        else if (option == "--artist" || option == "--title") {
+            std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+            (option == "--artist" ? filter.artist : filter.title) = value;
+        }
+        else {
+            std::cerr << "Unknown option " << option << "\n";
+            return false;
+        }
+        if (!valid) {
+            std::cerr << "Bad value for " << option << ": " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------- Merging libraries ----------
+// "--merge <out> <in>... [--policy first|last|highest|lowest]" collapses the songs of several playlist files
+// (PlayList.txt, songs.txt and priority.txt overlap heavily) into one file in a single pass: a song is
+// the same song when its title and artist match once the spaces around them and case are ignored;
+// it is written once, where it first appeared and as first written, with the rating the policy picks
+
+// which rating a duplicate keeps when its copies are rated differently
+enum class MergePolicy {
+    KEEP_FIRST,   // the rating seen first
+    KEEP_LAST,    // the rating seen last (a newer line wins, as songs.txt has always been read)
+    KEEP_HIGHEST,
+    KEEP_LOWEST
+};
+
+// the rating a song keeps when a copy rated 'incoming' turns up after one rated 'kept'
+inline int mergeRating(MergePolicy policy, int kept, int incoming) {
+    switch (policy) {
+    case MergePolicy::KEEP_FIRST: return kept;
+    case MergePolicy::KEEP_LAST: return incoming;
+    case MergePolicy::KEEP_HIGHEST: return std::max(kept, incoming);
+    case MergePolicy::KEEP_LOWEST: return std::min(kept, incoming);
+    }
+    return incoming;
+}
+
+// read "first", "last", "highest" or "lowest", returns false (with a message) on anything else
+bool parseMergePolicy(const std::string& name, MergePolicy& policy) {
+    if (name == "first") policy = MergePolicy::KEEP_FIRST;
+    else if (name == "last") policy = MergePolicy::KEEP_LAST;
+    else if (name == "highest") policy = MergePolicy::KEEP_HIGHEST;
+    else if (name == "lowest") policy = MergePolicy::KEEP_LOWEST;
+    else {
+        std::cerr << "Unknown merge policy " << name << " (expected first, last, highest or lowest)\n";
+        return false;
+    }
+    return true;
+}
+
+// the key two copies of a song share: trimmed lowercase title and artist, joined by the comma
+// that cannot occur in a title; built in 'key' so one buffer serves a whole file
+inline void songKey(std::string_view title, std::string_view artist, std::string& key) {
+    title = trimmed(title);
+    artist = trimmed(artist);
+    key.assign(title.data(), title.size());
+    key += ',';
+    key.append(artist.data(), artist.size());
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+}
+
+// merge the songs of every input file into outFile as described above; the output is written to a
+// temporary file and moved into place, so it may also be one of the inputs
+bool mergeSongFiles(const std::vector<std::string>& inFiles, const std::string& outFile, MergePolicy policy) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Song> merged;
+    std::unordered_map<std::string, std::size_t> byKey; // song key -> index in merged
+    std::string key;
+    std::size_t read = 0, duplicates = 0, conflicts = 0, skipped = 0;
+    for (const std::string& inFile : inFiles) {
+        bool ok = forEachSongInFile(inFile, [&](const SongFields& song) {
+            ++read;
+            songKey(song.title, song.artist, key);
+            auto found = byKey.find(key);
+            if (found == byKey.end()) {
+                byKey.emplace(key, merged.size());
+                merged.emplace_back(std::string(song.title), std::string(song.artist), song.rating);
+                return;
+            }
+            ++duplicates;
+            Song& kept = merged[found->second];
+            if (kept.rating != song.rating) {
+                ++conflicts;
+                kept.rating = mergeRating(policy, kept.rating, song.rating);
+            }
+        }, skipped);
+        if (!ok) return false;
+    }
+
+    std::string temporary = outFile + ".tmp";
+    std::ofstream out(temporary, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error opening file for writing.\n";
+        return false;
+    }
+    std::string buffer;
+    for (const Song& song : merged) {
+        buffer += song.toString();
+        buffer += '\n';
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), std::streamsize(buffer.size()));
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), std::streamsize(buffer.size()));
+    out.close();
+    if (!out || !replaceFile(temporary, outFile)) {
+        std::cerr << "Error writing " << outFile << ".\n";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::cout << "Merged " << read << " songs from " << inFiles.size() << " files: " << duplicates << " duplicates collapsed";
+    if (conflicts > 0) std::cout << " (" << conflicts << " with a different rating)";
+    std::cout << ", " << merged.size() << " songs written to " << outFile;
+    if (skipped > 0) std::cout << ", " << skipped << " unreadable lines skipped";
+    std::cout << " (" << elapsedMs(start) << " ms)\n";
+    return true;
+}
+
+// Write-ahead journal of playlist edits, so an edit appends one line instead of rewriting the playlist file
+// the journal starts with a header naming the snapshot (the playlist text file) it applies to by size and
+// FNV-1a hash, then holds one line per edit, naming songs by the ids the writing program gave them:
+//   A id title,artist,rating   song added at the end
+//   R id                       song removed
+//   U id title,artist,rating   removed song put back in its old place (undo)
+//   P id [id]                  that song's place: after the second id, or first without one (so it is
+//                              found again when the snapshot no longer had the song)
+//   S                          playlist sorted by rating
+//   T                          playlist sorted by rating, artist and title
+//   O id id ...                playlist order set back (undo of a sort)
+//   M id id ...                ids of the snapshot's songs, in file order (written after compaction when
+//                              the program's ids are not simply 0, 1, 2... as a fresh load would number them)
+// records are buffered and written with one fsync per commit(), so a crash loses at most the batch in
+// progress; compact() writes the playlist as a new snapshot and starts an empty journal for it
+class PlaylistJournal {
+public:
+    enum class RecordType : char { ADD = 'A', REMOVE = 'R', RESTORE = 'U', PLACE = 'P', SORT = 'S', SORT_ARTIST_TITLE = 'T', ORDER = 'O', MAP = 'M' };
+
+    // one parsed line of the journal
+    struct Record {
+        RecordType type = RecordType::SORT;
+        SongId id = kNoSong;        // ADD, REMOVE, RESTORE
+        SongFields fields;          // ADD, RESTORE
+        std::vector<SongId> ids;    // ORDER, MAP, PLACE
+    };
+
+    // a batch commits on its own past this many records, bulk edits included
+    static constexpr std::size_t kBatchRecords = 256;
+    // the journal is folded into the snapshot once it has this many records, or as many as the playlist has songs
+    static constexpr std::size_t kMinCompactRecords = 1000;
+
+private:
+    std::string snapshotFile;
+    std::string journalFile;
+    DurableFile file;
+    std::string pending;            // records not written yet
+    std::size_t pendingRecords = 0;
+    std::size_t journalRecords = 0; // records on top of the snapshot, written or not
+    bool tornTail = false;          // the file ends in the middle of a line (crash while appending)
+
+    // size and FNV-1a hash of the snapshot's bytes, written in the journal header
+    static std::string headerFor(const std::string& snapshot) {
+        MappedFile mapped(snapshot);
+        std::string_view data = mapped.data();
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char c : data) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        std::ostringstream header;
+        header << "#MPLJ 2 " << data.size() << ' ' << std::hex << hash << "\n";
+        return header.str();
+    }
+
+    void startRecord(RecordType type) {
+        if (tornTail) { // keep the damaged line apart from the new records
+            pending += '\n';
+            tornTail = false;
+        }
+        pending += char(type);
+    }
+
+    void endRecord() {
+        pending += '\n';
+        ++pendingRecords;
+        ++journalRecords;
+        if (pendingRecords >= kBatchRecords) commit();
+    }
+
+    // empty the journal and write the header of the current snapshot
+    bool startFresh() {
+        journalRecords = 0;
+        tornTail = false;
+        return file.open(journalFile, true) && file.append(headerFor(snapshotFile)) && file.sync();
+    }
+
+public:
+    explicit PlaylistJournal(const std::string& snapshot) : snapshotFile(snapshot) {
+        std::size_t dot = snapshot.find_last_of('.');
+        std::size_t slash = snapshot.find_last_of("/\\");
+        bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        journalFile = (hasExtension ? snapshot.substr(0, dot) : snapshot) + ".journal";
+    }
+
+    ~PlaylistJournal() { commit(); }
+
+    const std::string& fileName() const { return journalFile; }
+    std::size_t recordCount() const { return journalRecords; }
+
+    // split one journal line, returns false for a torn or damaged line
+    static bool parseRecord(std::string_view line, Record& record) {
+        record.type = RecordType(line[0]);
+        std::string_view rest = line.size() > 2 ? line.substr(2) : std::string_view();
+        auto readId = [&rest](SongId& id) {
+            auto parsed = std::from_chars(rest.data(), rest.data() + rest.size(), id);
+            if (parsed.ec != std::errc()) return false;
+            rest.remove_prefix(std::size_t(parsed.ptr - rest.data()));
+            if (!rest.empty() && rest.front() == ' ') rest.remove_prefix(1);
+            return true;
+        };
+        switch (record.type) {
+        case RecordType::ADD:
+        case RecordType::RESTORE:
+            return readId(record.id) && parseSongFields(rest, record.fields);
+        case RecordType::REMOVE:
+            return readId(record.id);
+        case RecordType::SORT:
+        case RecordType::SORT_ARTIST_TITLE:
+            return line.size() == 1;
+        case RecordType::ORDER:
+        case RecordType::MAP:
+        case RecordType::PLACE: {
+            record.ids.clear();
+            SongId id;
+            while (!rest.empty()) {
+                if (!readId(id)) return false;
+                record.ids.push_back(id);
+            }
+            return true;
+        }
+        }
+        return false;
+    }
+
+    // open the journal of the snapshot that was just loaded and call apply(record) for each record in it
+    // a journal written for another version of the snapshot (already compacted, or the file was edited
+    // outside the program) is set aside and a new one started; returns the number of records replayed
+    std::size_t open(const std::function<void(const Record&)>& apply) {
+        std::size_t replayed = 0;
+        bool matches = false;
+        bool hadRecords = false;
+        {
+            MappedFile existing(journalFile);
+            std::string_view data = existing.data();
+            std::string header = headerFor(snapshotFile);
+            matches = data.substr(0, header.size()) == header;
+            std::size_t firstLine = data.find('\n');
+            hadRecords = firstLine != std::string_view::npos && firstLine + 1 < data.size();
+            tornTail = !data.empty() && data.back() != '\n';
+            data.remove_prefix(matches ? header.size() : data.size());
+            Record record;
+            while (!data.empty()) {
+                std::size_t end = data.find('\n');
+                std::string_view line = data.substr(0, end);
+                data.remove_prefix(end == std::string_view::npos ? data.size() : end + 1);
+                if (line.empty() || !parseRecord(line, record)) continue; // torn or damaged record
+                apply(record);
+                ++replayed;
+            }
+        }
+        if (!matches) {
+            if (hadRecords) std::cout << "Journal " << journalFile << " does not match " << snapshotFile << ", ignored.\n";
+            startFresh();
+            return 0;
+        }
+        journalRecords = replayed;
+        file.open(journalFile, false);
+        return replayed;
+    }
+
+    // queue a record; it reaches the disk with the next commit()
+    void record(RecordType type, SongId id = kNoSong, std::string_view title = {}, std::string_view artist = {}, int rating = 0) {
+        startRecord(type);
+        if (id != kNoSong) {
+            pending += ' ';
+            pending += std::to_string(id);
+        }
+        if (type == RecordType::ADD || type == RecordType::RESTORE) {
+            pending += ' ';
+            pending.append(title.data(), title.size());
+            pending += ',';
+            pending.append(artist.data(), artist.size());
+            pending += ',';
+            pending += std::to_string(rating);
+        }
+        endRecord();
+    }
+
+    // queue a record that lists song ids (ORDER, MAP)
+    void recordIds(RecordType type, const std::vector<SongId>& ids) {
+        startRecord(type);
+        for (SongId id : ids) {
+            pending += ' ';
+            pending += std::to_string(id);
+        }
+        endRecord();
+    }
+
+    // write the queued records with a single fsync, returns false if they could not be written
+    bool commit() {
+        if (pending.empty()) return true;
+        bool written = file.isOpen() && file.append(pending) && file.sync();
+        if (!written) std::cerr << "Error writing journal " << journalFile << ".\n";
+        pending.clear();
+        pendingRecords = 0;
+        return written;
+    }
+
+    // time to fold the journal into a new snapshot?
+    bool needsCompaction(std::size_t songs) const {
+        return journalRecords >= std::max(kMinCompactRecords, songs);
+    }
+
+    // write a new snapshot with writeSnapshot(out), swap it in, and start an empty journal for it
+    // the new snapshot replaces the old one atomically; if the program stops before the journal is
+    // emptied, the old journal no longer matches the snapshot header and is ignored on the next start
+    bool compact(const std::function<void(std::ostream&)>& writeSnapshot) {
+        commit();
+        std::string temporary = snapshotFile + ".tmp";
+        {
+            std::ofstream out(temporary);
+            if (!out) return false;
+            writeSnapshot(out);
+            out.close();
+            if (!out) return false;
+        }
+        DurableFile written;
+        if (!written.open(temporary, false) || !written.sync()) return false;
+        written.close();
+        if (!replaceFile(temporary, snapshotFile)) return false;
+        return startFresh();
+    }
+};
+
+// orders a playlist can be viewed in without sorting it (see Playlist::sortedIds)
+enum class SortKey {
+    RATING,  // high to low, songs of one rating in playlist order
+    TITLE,   // A to Z ignoring case, then by artist
+    ARTIST   // A to Z ignoring case and surrounding spaces, then by title
+};
+
+// Ordered set of song ids kept as a treap in columns indexed by SongId (left child, right child, random
+// priority), so adding or removing a song costs O(log n) expected and nothing is allocated per song.
+// The order comes from a comparison on ids passed to each call, which reads the owner's own columns:
+// several views over one playlist share its song data and only add 12 bytes per slot each
+class SortedView {
+private:
+    std::vector<SongId> left, right;
+    std::vector<std::uint32_t> priority;
+    SongId root = kNoSong;
+    std::size_t count = 0;
+    std::uint32_t seed = 2463534242u;          // xorshift32 state for the priorities
+    std::vector<SongId> spine;                 // reused stack for build
+
+    std::uint32_t nextPriority() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    void makeRoom(SongId id) {
+        if (id < left.size()) return;
+        std::size_t size = std::max<std::size_t>(id + 1, 2 * left.size());
+        left.resize(size, kNoSong);
+        right.resize(size, kNoSong);
+        priority.resize(size, 0);
+    }
+
+    // split a subtree into the ids ordered before id and the rest
+    template <typename Less>
+    void split(SongId tree, SongId id, const Less& less, SongId& before, SongId& after) {
+        if (tree == kNoSong) {
+            before = after = kNoSong;
+            return;
+        }
+        if (less(tree, id)) {
+            split(right[tree], id, less, right[tree], after);
+            before = tree;
+        }
+        else {
+            split(left[tree], id, less, before, left[tree]);
+            after = tree;
+        }
+    }
+
+    // join two subtrees where every id of the first is ordered before the second
+    SongId merge(SongId first, SongId second) {
+        if (first == kNoSong) return second;
+        if (second == kNoSong) return first;
+        if (priority[first] > priority[second]) {
+            right[first] = merge(right[first], second);
+            return first;
+        }
+        left[second] = merge(first, left[second]);
+        return second;
+    }
+
+    template <typename Less>
+    SongId insertAt(SongId tree, SongId id, const Less& less) {
+        if (tree == kNoSong) return id;
+        if (priority[id] > priority[tree]) {
+            split(tree, id, less, left[id], right[id]);
+            return id;
+        }
+        if (less(id, tree)) left[tree] = insertAt(left[tree], id, less);
+        else right[tree] = insertAt(right[tree], id, less);
+        return tree;
+    }
+
+    template <typename Less>
+    SongId eraseAt(SongId tree, SongId id, const Less& less) {
+        if (tree == kNoSong) return kNoSong;
+        if (tree == id) return merge(left[id], right[id]);
+        if (less(id, tree)) left[tree] = eraseAt(left[tree], id, less);
+        else right[tree] = eraseAt(right[tree], id, less);
+        return tree;
+    }
+
+public:
+    std::size_t size() const { return count; }
+
+    // replace the contents with these ids, in O(n log n) for the sort and O(n) for the tree
+    template <typename Less>
+    void build(std::vector<SongId> ids, const Less& less, std::size_t threads) {
+        clear();
+        if (ids.empty()) return;
+        makeRoom(*std::max_element(ids.begin(), ids.end()));
+        parallelStableSort(ids, less, threads);
+        // the treap of sorted ids with random priorities, built left to right on a stack of its right spine
+        spine.clear();
+        for (SongId id : ids) {
+            priority[id] = nextPriority();
+            left[id] = right[id] = kNoSong;
+            SongId last = kNoSong;
+            while (!spine.empty() && priority[spine.back()] < priority[id]) {
+                last = spine.back();
+                spine.pop_back();
+            }
+            left[id] = last;
+            if (!spine.empty()) right[spine.back()] = id;
+            spine.push_back(id);
+        }
+        root = spine.front();
+        count = ids.size();
+    }
+
+    template <typename Less>
+    void insert(SongId id, const Less& less) {
+        makeRoom(id);
+        left[id] = right[id] = kNoSong;
+        priority[id] = nextPriority();
+        root = insertAt(root, id, less);
+        ++count;
+    }
+
+    // the id must be in the view, and compare as it did when it was inserted
+    template <typename Less>
+    void erase(SongId id, const Less& less) {
+        root = eraseAt(root, id, less);
+        --count;
+    }
+
+    // call fn(id) for every id in order; the stack is the walk's own, so walks may run in several threads
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        std::vector<SongId> walk; // O(log n) deep
+        SongId node = root;
+        while (node != kNoSong || !walk.empty()) {
+            while (node != kNoSong) {
+                walk.push_back(node);
+                node = left[node];
+            }
+            node = walk.back();
+            walk.pop_back();
+            fn(node);
+            node = right[node];
+        }
+    }
+
+    void clear() {
+        root = kNoSong;
+        count = 0;
+    }
+
+    // bytes held by the columns
+    std::size_t memoryUsage() const {
+        return (left.capacity() + right.capacity() + spine.capacity()) * sizeof(SongId) + priority.capacity() * sizeof(std::uint32_t);
+    }
+};
+
+// Playlist stored column by column: each song occupies a slot (its SongId) in dense arrays of
+// interned title/artist ids and ratings, and the playlist order is a doubly linked list threaded
+// through the slots by index instead of a heap-allocated node per song
+// songs are also chained into one bucket per rating (kept in playlist order), so sorting by rating
+// is a counting sort and "rating >= k" only walks the qualifying buckets
+class Playlist {
+private:
+    static constexpr std::uint8_t kFreeSlot = 0;  // rating of a slot that holds no song
+    static constexpr std::uint8_t kRetired = 0x80; // rating flag of a removed song whose slot is kept for undo
+    static constexpr std::size_t kMinPurge = 1024; // freed slots collected before the search index is purged
+
+    StringPool strings;                    // titles and interned artists, original and lowercase
+    std::vector<StringId> titles;          // slot -> title
+    std::vector<StringId> artists;         // slot -> artist
+    std::vector<StringId> lowerTitles;     // slot -> lowercase title (same id as the title when already lowercase)
+    std::vector<StringId> lowerArtists;    // slot -> lowercase artist
+    std::vector<std::uint8_t> ratings;     // slot -> rating (kFreeSlot when unused, | kRetired when removed but kept)
+    std::vector<SongId> prevSong;          // slot -> previous song in playlist order
+    std::vector<SongId> nextSong;          // slot -> next song in playlist order
+    std::vector<SongId> bucketPrev;        // slot -> previous song with the same rating
+    std::vector<SongId> bucketNext;        // slot -> next song with the same rating
+    SongId bucketFirst[kMaxRating + 1];    // rating -> first song of its bucket
+    SongId bucketLast[kMaxRating + 1];     // rating -> last song of its bucket
+    std::size_t bucketCount[kMaxRating + 1] = {}; // rating -> number of songs
+    std::vector<SongId> freeSlots;         // slots left behind by removed songs
+    std::vector<SongId> purgeSlots;        // freed slots still listed in the search index, reused after a purge
+    std::vector<bool> purgeMarks;          // slot -> freed, during a purge (kept to reuse its storage)
+    SongId firstSong = kNoSong;
+    SongId lastSong = kNoSong;
+    std::size_t songCount = 0;
+    // the songs of one artist; artists written with other capitals or surrounding spaces ("Arthur Nery "
+    // and "arthur nery") are the same artist, and each rating has its own list so listing the songs of an
+    // artist by rating only visits those songs
+    struct ArtistEntry {
+        StringId name = 0;                 // as written for its first song
+        std::size_t songs = 0;
+        std::size_t ratingTotal = 0;       // for the average rating
+        SongId first[kMaxRating + 1];      // rating -> first song of this artist with it
+        SongId last[kMaxRating + 1];       // rating -> last song of this artist with it
+    };
+    std::vector<ArtistEntry> artistEntries;
+    FlatStringMap artistIndex;             // trimmed lowercase artist -> entry
+    std::vector<std::uint32_t> artistEntryOf; // slot -> entry
+    std::vector<SongId> artistPrev;        // slot -> previous song of the same artist and rating
+    std::vector<SongId> artistNext;        // slot -> next song of the same artist and rating
+    // lowercase title -> ids of songs with that title, oldest first (duplicate titles like "Lonely" share one entry)
+    FlatStringMap titleIndex;
+    std::vector<SongId> sameTitleNext;     // slot -> next (newer) song with the same lowercase title
+    // substring search over titles and artists, built on the first search after a load and kept up to
+    // date by every add from then on; removed songs stay listed (and are filtered out of the results)
+    // until their slot is freed, then they are purged in batches
+    mutable TrigramIndex titleSearch;
+    mutable TrigramIndex artistSearch;
+    mutable bool searchIndexed = true;
+    // views by title and by artist (the rating buckets are the rating view), built on first use and kept
+    // in order by every add, remove and undo from then on
+    mutable SortedView views[2];           // SortKey::TITLE, SortKey::ARTIST
+    mutable bool viewBuilt[2] = {};
+    // distinct lowercase titles for typo-tolerant lookup, built on the first fuzzy query and given every
+    // new title from then on; titles no song has any more are skipped, and rebuilt away once they dominate
+    mutable TitleDictionary fuzzyTitles;
+    mutable bool fuzzyIndexed = false;
+    bool verbose = true;       // print a line for every add/remove
+    std::string foldBuffer;    // reused for lowercasing while adding songs
+    PlaylistJournal* journal = nullptr; // edits are recorded here when attached
+    std::size_t threads = 0;   // worker threads for loads, sorts and listings (0: one per core)
+
+    // function to convert a string to lowercase
+    std::string toLowerCase(std::string_view str) const {
+        std::string lowerStr(str);
+        std::transform(lowerStr.begin(), lowerStr.end(), lowerStr.begin(), ::tolower);
+        return lowerStr;
+    }
+
+    // lowercase a string into the reusable buffer
+    const std::string& fold(std::string_view str) {
+        foldBuffer.assign(str.data(), str.size());
+        std::transform(foldBuffer.begin(), foldBuffer.end(), foldBuffer.begin(), ::tolower);
+        return foldBuffer;
+    }
+
+    // store a song in a free slot at the end of the playlist and index it
+    SongId insertSong(std::string_view title, std::string_view artist, int rating) {
+        StringId artistId = strings.intern(artist);
+        return insertSong(title, artistId, fold(artist) == artist ? artistId : strings.intern(foldBuffer), rating);
+    }
+
+    // same, for an artist already in the string pool
+    SongId insertSong(std::string_view title, StringId artistId, StringId lowerArtistId, int rating) {
+        return insertSong(title, fold(title), artistId, lowerArtistId, rating);
+    }
+
+    // same, with the lowercase title already worked out
+    SongId insertSong(std::string_view title, std::string_view lowerTitle, StringId artistId, StringId lowerArtistId, int rating) {
+        SongId id = allocateSlot();
+        titles[id] = strings.add(title);
+        lowerTitles[id] = lowerTitle == title ? titles[id] : strings.add(lowerTitle);
+        artists[id] = artistId;
+        lowerArtists[id] = lowerArtistId;
+        ratings[id] = std::uint8_t(std::clamp(rating, kMinRating, kMaxRating)); // out-of-range input is pinned to 1..5
+        linkLast(id);
+        linkBucket(id);
+        artistEntryOf[id] = artistEntryFor(artistId, lowerArtistId);
+        linkArtist(id);
+        ++songCount;
+        if (searchIndexed) {
+            titleSearch.add(id, strings.view(lowerTitles[id]));
+            artistSearch.add(id, strings.view(lowerArtists[id]));
+        }
+        // append to the chain of songs sharing this title, so the oldest stays first
+        sameTitleNext[id] = kNoSong;
+        auto inserted = titleIndex.insert(strings.view(lowerTitles[id]), id);
+        if (!inserted.second) {
+            SongId last = *inserted.first;
+            while (sameTitleNext[last] != kNoSong) last = sameTitleNext[last];
+            sameTitleNext[last] = id;
+        }
+        else if (fuzzyIndexed) fuzzyTitles.insert(strings.view(lowerTitles[id]));
+        addToViews(id);
+        return id;
+    }
+
+    // is song a before song b in a view; ties end on the id, so every song has one place
+    bool orderedBefore(SortKey key, SongId a, SongId b) const {
+        std::string_view titleA = strings.view(lowerTitles[a]), titleB = strings.view(lowerTitles[b]);
+        std::string_view artistA = trimmed(strings.view(lowerArtists[a])), artistB = trimmed(strings.view(lowerArtists[b]));
+        int first = key == SortKey::TITLE ? titleA.compare(titleB) : artistA.compare(artistB);
+        if (first != 0) return first < 0;
+        int second = key == SortKey::TITLE ? artistA.compare(artistB) : titleA.compare(titleB);
+        if (second != 0) return second < 0;
+        return a < b;
+    }
+
+    // the comparison a view is kept in
+    auto viewOrder(SortKey key) const {
+        return [this, key](SongId a, SongId b) { return orderedBefore(key, a, b); };
+    }
+
+    static SortKey viewKey(std::size_t view) { return view == 0 ? SortKey::TITLE : SortKey::ARTIST; }
+
+    void addToViews(SongId id) {
+        for (std::size_t view = 0; view < 2; ++view)
+            if (viewBuilt[view]) views[view].insert(id, viewOrder(viewKey(view)));
+    }
+
+    void removeFromViews(SongId id) {
+        for (std::size_t view = 0; view < 2; ++view)
+            if (viewBuilt[view]) views[view].erase(id, viewOrder(viewKey(view)));
+    }
+
+    // make room for this many songs up front
+    void reserve(std::size_t count) {
+        titles.reserve(count);
+        artists.reserve(count);
+        lowerTitles.reserve(count);
+        lowerArtists.reserve(count);
+        ratings.reserve(count);
+        prevSong.reserve(count);
+        nextSong.reserve(count);
+        bucketPrev.reserve(count);
+        bucketNext.reserve(count);
+        artistEntryOf.reserve(count);
+        artistPrev.reserve(count);
+        artistNext.reserve(count);
+        sameTitleNext.reserve(count);
+        strings.reserve(2 * count);
+        titleIndex.reserve(count);
+    }
+
+    // take a free slot, or grow the columns by one
+    SongId allocateSlot() {
+        if (!freeSlots.empty()) {
+            SongId id = freeSlots.back();
+            freeSlots.pop_back();
+            return id;
+        }
+        titles.push_back(0);
+        artists.push_back(0);
+        lowerTitles.push_back(0);
+        lowerArtists.push_back(0);
+        ratings.push_back(kFreeSlot);
+        prevSong.push_back(kNoSong);
+        nextSong.push_back(kNoSong);
+        bucketPrev.push_back(kNoSong);
+        bucketNext.push_back(kNoSong);
+        artistEntryOf.push_back(0);
+        artistPrev.push_back(kNoSong);
+        artistNext.push_back(kNoSong);
+        sameTitleNext.push_back(kNoSong);
+        return SongId(ratings.size() - 1);
+    }
+
+    // put a slot at the end of its rating bucket
+    void linkBucket(SongId id) {
+        int rating = ratings[id];
+        bucketPrev[id] = bucketLast[rating];
+        bucketNext[id] = kNoSong;
+        if (bucketLast[rating] != kNoSong) bucketNext[bucketLast[rating]] = id;
+        else bucketFirst[rating] = id;
+        bucketLast[rating] = id;
+        ++bucketCount[rating];
+    }
+
+    // chain every song into its rating bucket again in playlist order, after the order was changed by
+    // anything but a rating sort, so the next rating sort keeps the songs of one rating in that order
+    void relinkBuckets() {
+        std::fill(std::begin(bucketFirst), std::end(bucketFirst), kNoSong);
+        std::fill(std::begin(bucketLast), std::end(bucketLast), kNoSong);
+        std::fill(std::begin(bucketCount), std::end(bucketCount), 0);
+        for (SongId id = firstSong; id != kNoSong; id = nextSong[id]) linkBucket(id);
+    }
+
+    // take a slot out of its rating bucket
+    void unlinkBucket(SongId id) {
+        int rating = ratings[id];
+        if (bucketPrev[id] != kNoSong) bucketNext[bucketPrev[id]] = bucketNext[id];
+        else bucketFirst[rating] = bucketNext[id];
+        if (bucketNext[id] != kNoSong) bucketPrev[bucketNext[id]] = bucketPrev[id];
+        else bucketLast[rating] = bucketPrev[id];
+        --bucketCount[rating];
+    }
+
+    // entry of an artist, created the first time the artist is seen
+    std::uint32_t artistEntryFor(StringId artistId, StringId lowerArtistId) {
+        auto inserted = artistIndex.insert(trimmed(strings.view(lowerArtistId)), std::uint32_t(artistEntries.size()));
+        if (inserted.second) {
+            artistEntries.emplace_back();
+            ArtistEntry& entry = artistEntries.back();
+            entry.name = artistId;
+            std::fill(std::begin(entry.first), std::end(entry.first), kNoSong);
+            std::fill(std::begin(entry.last), std::end(entry.last), kNoSong);
+        }
+        return *inserted.first;
+    }
+
+    // entry of an artist by name (any case, surrounding spaces ignored), nullptr when no song has it
+    const ArtistEntry* findArtist(const std::string& artist) const {
+        const std::uint32_t* found = artistIndex.findFolded(trimmed(artist));
+        return found && artistEntries[*found].songs > 0 ? &artistEntries[*found] : nullptr;
+    }
+
+    // put a slot at the end of its artist's list for its rating
+    void linkArtist(SongId id) {
+        ArtistEntry& entry = artistEntries[artistEntryOf[id]];
+        int rating = ratings[id];
+        artistPrev[id] = entry.last[rating];
+        artistNext[id] = kNoSong;
+        if (entry.last[rating] != kNoSong) artistNext[entry.last[rating]] = id;
+        else entry.first[rating] = id;
+        entry.last[rating] = id;
+        ++entry.songs;
+        entry.ratingTotal += rating;
+    }
+
+    // take a slot out of its artist's list
+    void unlinkArtist(SongId id) {
+        ArtistEntry& entry = artistEntries[artistEntryOf[id]];
+        int rating = ratings[id];
+        if (artistPrev[id] != kNoSong) artistNext[artistPrev[id]] = artistNext[id];
+        else entry.first[rating] = artistNext[id];
+        if (artistNext[id] != kNoSong) artistPrev[artistNext[id]] = artistPrev[id];
+        else entry.last[rating] = artistPrev[id];
+        --entry.songs;
+        entry.ratingTotal -= rating;
+    }
+
+    // put a slot at the end of the playlist order
+    void linkLast(SongId id) {
+        prevSong[id] = lastSong;
+        nextSong[id] = kNoSong;
+        if (lastSong != kNoSong) nextSong[lastSong] = id;
+        else firstSong = id;
+        lastSong = id;
+    }
+
+    // put a slot right after another one in the playlist order, or first for kNoSong
+    void linkAfter(SongId id, SongId before) {
+        prevSong[id] = before;
+        nextSong[id] = before != kNoSong ? nextSong[before] : firstSong;
+        if (before != kNoSong) nextSong[before] = id;
+        else firstSong = id;
+        if (nextSong[id] != kNoSong) prevSong[nextSong[id]] = id;
+        else lastSong = id;
+    }
+
+    // take a slot out of the playlist order
+    void unlink(SongId id) {
+        if (prevSong[id] != kNoSong) nextSong[prevSong[id]] = nextSong[id];
+        else firstSong = nextSong[id];
+        if (nextSong[id] != kNoSong) prevSong[nextSong[id]] = prevSong[id];
+        else lastSong = prevSong[id];
+    }
+
+    bool isLive(SongId id) const { return id < ratings.size() && ratings[id] != kFreeSlot && !(ratings[id] & kRetired); }
+    bool isRetired(SongId id) const { return id < ratings.size() && (ratings[id] & kRetired); }
+
+    // take a song out of the order, its bucket and its title chain, keeping the slot and its links
+    void retireSlot(SongId id) {
+        unlink(id);
+        unlinkBucket(id);
+        unlinkArtist(id);
+        SongId* head = titleIndex.find(strings.view(lowerTitles[id]));
+        if (*head == id) { // first of its title: the next one takes its place, and the key uses its text
+            if (sameTitleNext[id] == kNoSong) titleIndex.erase(strings.view(lowerTitles[id]));
+            else {
+                *head = sameTitleNext[id];
+                titleIndex.moveKey(strings.view(lowerTitles[id]), strings.view(lowerTitles[*head]));
+            }
+        }
+        else {
+            SongId before = *head;
+            while (sameTitleNext[before] != id) before = sameTitleNext[before];
+            sameTitleNext[before] = sameTitleNext[id];
+        }
+        removeFromViews(id);
+        ratings[id] |= kRetired;
+        --songCount;
+    }
+
+    // put a retired song back where it was
+    // dancing links: the slot still holds its old neighbours in the order, the bucket and the title chain,
+    // and they are its neighbours again once everything done after the removal has been undone
+    void restoreSlot(SongId id) {
+        ratings[id] &= ~kRetired;
+        if (prevSong[id] != kNoSong) nextSong[prevSong[id]] = id;
+        else firstSong = id;
+        if (nextSong[id] != kNoSong) prevSong[nextSong[id]] = id;
+        else lastSong = id;
+        int rating = ratings[id];
+        if (bucketPrev[id] != kNoSong) bucketNext[bucketPrev[id]] = id;
+        else bucketFirst[rating] = id;
+        if (bucketNext[id] != kNoSong) bucketPrev[bucketNext[id]] = id;
+        else bucketLast[rating] = id;
+        ++bucketCount[rating];
+        ArtistEntry& entry = artistEntries[artistEntryOf[id]];
+        if (artistPrev[id] != kNoSong) artistNext[artistPrev[id]] = id;
+        else entry.first[rating] = id;
+        if (artistNext[id] != kNoSong) artistPrev[artistNext[id]] = id;
+        else entry.last[rating] = id;
+        ++entry.songs;
+        entry.ratingTotal += rating;
+        auto inserted = titleIndex.insert(strings.view(lowerTitles[id]), id);
+        if (!inserted.second) { // in front of the song that followed it in the chain
+            if (*inserted.first == sameTitleNext[id]) {
+                *inserted.first = id;
+                titleIndex.moveKey(strings.view(lowerTitles[id]), strings.view(lowerTitles[id]));
+            }
+            else {
+                SongId before = *inserted.first;
+                while (sameTitleNext[before] != sameTitleNext[id]) before = sameTitleNext[before];
+                sameTitleNext[before] = id;
+            }
+        }
+        else if (fuzzyIndexed) fuzzyTitles.insert(strings.view(lowerTitles[id]));
+        addToViews(id);
+        ++songCount;
+    }
+
+    // make a slot that nothing lists any more reusable, with the pool bytes of its title
+    // (the title index never keeps a freed song's text as its key, see retireSlot)
+    void freeSlot(SongId id) {
+        strings.release(titles[id]);
+        if (lowerTitles[id] != titles[id]) strings.release(lowerTitles[id]);
+        freeSlots.push_back(id);
+    }
+
+    // free a retired slot for reuse; while the search index still lists it, it waits for the next purge
+    void releaseSlot(SongId id) {
+        ratings[id] = kFreeSlot;
+        if (!searchIndexed) {
+            freeSlot(id);
+            return;
+        }
+        purgeSlots.push_back(id);
+        if (purgeSlots.size() >= std::max(kMinPurge, songCount / 8)) purgeSearchIndex();
+    }
+
+    // drop the freed slots from the search index in one pass, then make them reusable
+    void purgeSearchIndex() {
+        purgeMarks.assign(ratings.size(), false);
+        for (SongId id : purgeSlots) purgeMarks[id] = true;
+        titleSearch.purge(purgeMarks);
+        artistSearch.purge(purgeMarks);
+        for (SongId id : purgeSlots) freeSlot(id);
+        purgeSlots.clear();
+    }
+
+    // remove the song in a slot from the order and every index, and free the slot
+    void removeSlot(SongId id) {
+        retireSlot(id);
+        releaseSlot(id);
+    }
+
+    // keep only the ids of songs still in the playlist
+    std::vector<SongId> liveOnly(std::vector<SongId> ids) const {
+        ids.erase(std::remove_if(ids.begin(), ids.end(), [this](SongId id) { return !isLive(id); }), ids.end());
+        return ids;
+    }
+
+    // slot of the oldest song with this title (case-insensitive), or kNoSong
+    SongId findSlot(const std::string& title) const {
+        const SongId* found = titleIndex.findFolded(title); // hash lookup instead of scanning the whole playlist
+        return found ? *found : kNoSong;
+    }
+
+    // index every song for substring search, done once on the first search after a load
+    // (retired songs too, so undo can bring them back without touching the index)
+    void buildSearchIndex() const {
+        if (searchIndexed) return;
+        titleSearch.reserve(songCount);
+        for (SongId id = 0; id < ratings.size(); ++id) {
+            if (ratings[id] == kFreeSlot) continue;
+            titleSearch.add(id, strings.view(lowerTitles[id]));
+            artistSearch.add(id, strings.view(lowerArtists[id]));
+        }
+        searchIndexed = true;
+    }
+
+    // put every title in the fuzzy index, on the first fuzzy query after a load, or again once most of
+    // the titles it holds have left the playlist
+    void buildFuzzyIndex() const {
+        if (fuzzyIndexed && fuzzyTitles.size() <= 2 * titleIndex.size() + 1024) return;
+        std::vector<std::string_view> distinct;
+        distinct.reserve(titleIndex.size());
+        for (SongId id = firstSong; id != kNoSong; id = nextSong[id])
+            if (*titleIndex.find(strings.view(lowerTitles[id])) == id) distinct.push_back(strings.view(lowerTitles[id]));
+        fuzzyTitles.build(std::move(distinct));
+        fuzzyIndexed = true;
+    }
+
+    // sort a view on its first use
+    void buildView(std::size_t view) const {
+        if (viewBuilt[view]) return;
+        views[view].build(allIds(), viewOrder(viewKey(view)), threads);
+        viewBuilt[view] = true;
+    }
+
+    // print the table header used by the playlist listings
+    void printHeader() const {
+        std::cout << std::setw(35) << std::left << "TITLE"
+            << std::setw(20) << std::left << "ARTIST"
+            << std::setw(10) << std::right << "RATING\n";
+        std::cout << std::setfill('-') << std::setw(65) << "" << std::setfill(' ') << '\n'; 
+    }
+
+    // append one song as a table row: title and artist padded to 35 and 20 columns, then "   [ r/5 ] "
+    void appendRow(std::string& out, SongId id) const {
+        std::string_view title = titleOf(id), artist = artistOf(id);
+        out.append(title.data(), title.size());
+        if (title.size() < 35) out.append(35 - title.size(), ' ');
+        out.append(artist.data(), artist.size());
+        if (artist.size() < 20) out.append(20 - artist.size(), ' ');
+        out += "   [ ";
+        out += char('0' + ratings[id]);
+        out += "/5 ] \n";
+    }
+
+    // print songs as table rows; long listings are formatted by several threads, one piece each,
+    // and written in order
+    void printRows(const std::vector<SongId>& ids) const {
+        std::size_t parts = threadsFor(threads, ids.size(), kParallelMinItems);
+        std::vector<std::string> text(parts);
+        runParallel(parts, [&](std::size_t part) {
+            std::size_t first = ids.size() * part / parts, last = ids.size() * (part + 1) / parts;
+            text[part].reserve((last - first) * 72);
+            for (std::size_t i = first; i < last; ++i) appendRow(text[part], ids[i]);
+        });
+        for (const std::string& piece : text) std::cout.write(piece.data(), std::streamsize(piece.size()));
+    }
+
+    // print the songs found by a search, or a message when there are none
+    bool printMatches(const std::vector<SongId>& ids, const std::string& what, const std::string& query) const {
+        for (SongId id : ids) {
+            std::cout << "Song found: " << titleOf(id) << " by " << artistOf(id) << "\n";
+        }
+        if (ids.empty()) std::cout << "No song found with the " << what << " containing: " << query << "\n";
+        return !ids.empty();
+    }
+
+public:
+    Playlist() {
+        std::fill(std::begin(bucketFirst), std::end(bucketFirst), kNoSong);
+        std::fill(std::begin(bucketLast), std::end(bucketLast), kNoSong);
+    }
+
+    // turn the per-song messages on or off (bulk work such as benchmarks runs quiet)
+    void setVerbose(bool on) { verbose = on; }
+
+    // worker threads for loading, sorting and listing large playlists (0: one per core)
+    void setThreads(std::size_t count) { threads = count; }
+
+    // build the search index now rather than on the first search, so that searches only read
+    // (needed before other threads search the playlist at the same time)
+    void prepareSearch() const { buildSearchIndex(); }
+
+    // build everything a query would otherwise build on first use (the search index, the sorted views and
+    // the fuzzy index), so that queries only read; for a copy other threads read at the same time
+    void prepareReads() const {
+        buildSearchIndex();
+        buildView(0);
+        buildView(1);
+        buildFuzzyIndex();
+    }
+
+    std::size_t size() const { return songCount; }
+
+    // stop updating the search index on every add; it is built in one pass by the next search
+    // (for bulk adds, like the load functions do)
+    void deferSearchIndex() {
+        titleSearch.clear();
+        artistSearch.clear();
+        searchIndexed = false;
+        for (SongId id : purgeSlots) freeSlot(id); // with their titles' pool bytes, as a purge frees them
+        purgeSlots.clear();
+    }
+
+    // record adds, removes and sorts in this journal from now on (nullptr stops recording)
+    void attachJournal(PlaylistJournal* target) { journal = target; }
+
+    // apply the edits recorded in a journal on top of the songs just loaded, then keep recording there
+    void replayJournal(PlaylistJournal& target) {
+        using RecordType = PlaylistJournal::RecordType;
+        auto start = std::chrono::steady_clock::now();
+        bool wasVerbose = verbose;
+        verbose = false;
+        journal = nullptr;
+        // the journal names songs by the ids of the program that wrote it: the songs of a fresh load
+        // keep theirs unless a MAP record says otherwise, and added songs map to the slots they get here;
+        // any other id is a song removed before the snapshot was written (still undoable then), which a
+        // fresh load does not have, even when an added song takes that slot number here
+        std::unordered_map<SongId, SongId> ids;
+        bool sameIds = true;
+        const SongId snapshotSongs = SongId(ratings.size());
+        auto mapped = [&](SongId id) {
+            auto found = ids.find(id);
+            return found != ids.end() ? found->second : sameIds && id < snapshotSongs ? id : kNoSong;
+        };
+        std::vector<SongId> retiredHere;
+        std::size_t replayed = target.open([&](const PlaylistJournal::Record& record) {
+            switch (record.type) {
+            case RecordType::ADD:
+                ids[record.id] = insertSong(record.fields.title, record.fields.artist, record.fields.rating);
+                break;
+            case RecordType::REMOVE: {
+                SongId id = mapped(record.id);
+                if (isLive(id)) {
+                    retireSlot(id); // kept until the end, a RESTORE may follow
+                    retiredHere.push_back(id);
+                }
+                break;
+            }
+            case RecordType::RESTORE: {
+                SongId id = mapped(record.id);
+                if (isRetired(id)) restoreSlot(id);
+                else ids[record.id] = insertSong(record.fields.title, record.fields.artist, record.fields.rating); // removed before the snapshot: at the end, until its PLACE record
+                break;
+            }
+            case RecordType::PLACE: { // where the restored song was, when it came back at the end above
+                if (record.ids.empty()) break;
+                SongId id = mapped(record.ids[0]);
+                SongId before = record.ids.size() > 1 ? mapped(record.ids[1]) : kNoSong;
+                if (!isLive(id) || (record.ids.size() > 1 && !isLive(before)) || prevSong[id] == before) break;
+                unlink(id);
+                linkAfter(id, before);
+                relinkBuckets(); // each rating's bucket follows the playlist order
+                break;
+            }
+            case RecordType::SORT:
+                sortByRating();
+                break;
+            case RecordType::SORT_ARTIST_TITLE:
+                sortByRatingArtistTitle();
+                break;
+            case RecordType::ORDER: {
+                std::vector<SongId> order;
+                for (SongId id : record.ids) order.push_back(mapped(id));
+                restoreOrder(order);
+                break;
+            }
+            case RecordType::MAP: {
+                std::vector<SongId> order = orderIds();
+                for (std::size_t i = 0; i < record.ids.size() && i < order.size(); ++i) ids[record.ids[i]] = order[i];
+                sameIds = false;
+                break;
+            }
+            }
+        });
+        for (SongId id : retiredHere)
+            if (isRetired(id)) releaseSlot(id); // no undo history survives a restart
+        verbose = wasVerbose;
+        journal = &target;
+        if (replayed > 0)
+            std::cout << "Journal " << target.fileName() << " replayed: " << replayed << " edits (" << elapsedMs(start) << " ms)\n";
+    }
+
+    // write the playlist as the journal's new snapshot and start the next journal, returns false on error
+    bool compactJournal() {
+        if (!journal || !journal->compact([this](std::ostream& out) { writeText(out); })) return false;
+        // a fresh load numbers the snapshot's songs 0, 1, 2...; if the ids here differ, record which is which
+        std::vector<SongId> order = orderIds();
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            if (order[i] != i) {
+                journal->recordIds(PlaylistJournal::RecordType::MAP, order);
+                return journal->commit();
+            }
+        }
+        return true;
+    }
+
+    // Add song to playlist, returns its id
+    SongId addSong(const Song& song) {
+        OperationTimer timer(Operation::PLAYLIST_ADD);
+        operationStats.count(Counter::SONGS_ADDED);
+        SongId id = insertSong(song.title, song.artist, song.rating);
+        if (journal) journal->record(PlaylistJournal::RecordType::ADD, id, titleOf(id), artistOf(id), ratings[id]);
+        if (verbose) std::cout << "Song '" << song.title << "' by " << song.artist << " added to the playlist.\n";
+        return id;
+    }
+
+    // Remove song from playlist by title
+    void removeSong(const std::string& songTitle) {
+        OperationTimer timer(Operation::PLAYLIST_REMOVE);
+        SongId id = findSlot(songTitle);   // the oldest song with this title, same one findSong returns
+        if (id != kNoSong) {
+            operationStats.count(Counter::SONGS_REMOVED);
+            if (verbose) std::cout << "Song '" << titleOf(id) << "' removed from the playlist.\n";
+            if (journal) journal->record(PlaylistJournal::RecordType::REMOVE, id);
+            removeSlot(id);
+            return;   // Exit the function once the song is removed
+        }
+        //if not found to the list
+        if (verbose) std::cout << "Song '" << songTitle<< "' not found in the playlist.\n";
+    }
+
+    // id of the oldest song with this title (case-insensitive), or kNoSong
+    SongId findSongId(const std::string& title) const { return findSlot(title); }
+
+    // remove a song but keep its slot, so restoreSong can put it back in O(1); returns false if it is
+    // not in the playlist (the slot stays taken until releaseSong)
+    bool retireSong(SongId id) {
+        if (!isLive(id)) return false;
+        operationStats.count(Counter::SONGS_REMOVED);
+        if (verbose) std::cout << "Song '" << titleOf(id) << "' removed from the playlist.\n";
+        if (journal) journal->record(PlaylistJournal::RecordType::REMOVE, id);
+        retireSlot(id);
+        return true;
+    }
+
+    // put a song removed by retireSong back in its old place; only valid while every edit made after
+    // the removal has been undone (the order an undo log works in)
+    bool restoreSong(SongId id) {
+        if (!isRetired(id)) return false;
+        restoreSlot(id);
+        if (journal) {
+            journal->record(PlaylistJournal::RecordType::RESTORE, id, titleOf(id), artistOf(id), ratings[id]);
+            std::vector<SongId> place{ id };
+            if (prevSong[id] != kNoSong) place.push_back(prevSong[id]);
+            journal->recordIds(PlaylistJournal::RecordType::PLACE, place);
+        }
+        return true;
+    }
+
+    // give up a song removed by retireSong, its slot can be reused
+    void releaseSong(SongId id) {
+        if (isRetired(id)) releaseSlot(id);
+    }
+
+    bool isVerbose() const { return verbose; }
+
+    // fields of the song stored under an id returned by the search functions
+    std::string_view titleOf(SongId id) const { return strings.view(titles[id]); }
+    std::string_view artistOf(SongId id) const { return strings.view(artists[id]); }
+    int ratingOf(SongId id) const { return ratings[id] & ~kRetired; }
+    // number of the song's artist: songs whose artists match ignoring case and surrounding spaces share it
+    std::uint32_t artistNumberOf(SongId id) const { return artistEntryOf[id]; }
+
+    // number of songs with exactly this rating
+    std::size_t ratingCount(int rating) const {
+        return rating >= kMinRating && rating <= kMaxRating ? bucketCount[rating] : 0;
+    }
+
+    // copy of the song stored under an id
+    Song getSong(SongId id) const { return Song(std::string(titleOf(id)), std::string(artistOf(id)), ratings[id]); }
+
+    // Display all songs in playlist
+    void displayPlaylist() const {
+        if (songCount == 0) {  
+            std::cout << "The playlist is empty.\n";
+            return;
+        }
+        std::cout << "********** PLAYLIST **********\n";
+        printHeader();
+        // iterate over the songs and display their details
+        printRows(orderIds());
+    }
+
+    // Display the given songs as a table, in the order given
+    void displaySongs(const std::vector<SongId>& ids) const {
+        printHeader();
+        printRows(ids);
+    }
+
+    // ids of every song in a view's order, without reordering the playlist: the rating view is the rating
+    // buckets, the title and artist views are sorted once on first use and kept in order by every edit
+    // after that, so showing a sorted playlist after an edit costs no sort
+    std::vector<SongId> sortedIds(SortKey key) const {
+        std::vector<SongId> ids;
+        ids.reserve(songCount);
+        if (key == SortKey::RATING) {
+            for (int rating = kMaxRating; rating >= kMinRating; --rating)
+                for (SongId id = bucketFirst[rating]; id != kNoSong; id = bucketNext[id]) ids.push_back(id);
+            return ids;
+        }
+        std::size_t view = key == SortKey::TITLE ? 0 : 1;
+        buildView(view);
+        views[view].forEach([&ids](SongId id) { ids.push_back(id); });
+        return ids;
+    }
+
+    // Display the playlist in a view's order, leaving the playlist order as it is
+    void displaySorted(SortKey key) const {
+        if (songCount == 0) {
+            std::cout << "The playlist is empty.\n";
+            return;
+        }
+        static const char* const names[] = { "RATING", "TITLE", "ARTIST" };
+        std::cout << "********** PLAYLIST BY " << names[int(key)] << " **********\n";
+        displaySongs(sortedIds(key));
+    }
+
+    // ids of songs whose title contains the text (case-insensitive), ordered by id
+    std::vector<SongId> searchTitleIds(const std::string& title) const {
+        std::string lowerTitle = toLowerCase(title);
+        OperationTimer timer(Operation::PLAYLIST_SEARCH);
+        if (lowerTitle.empty()) return allIds();
+        buildSearchIndex();
+        return liveOnly(titleSearch.search(lowerTitle, [this](SongId id) { return strings.view(lowerTitles[id]); }));
+    }
+
+    // songs whose title is within a few typos of the text (case and surrounding spaces ignored): at most
+    // limit ids, the closest titles first and the best rated first among them; the edit distance allowed
+    // grows with the text, 1 up to 4 characters, 2 up to 8 and 3 beyond
+    std::vector<SongId> fuzzyTitleIds(const std::string& title, std::size_t limit = 10) const {
+        std::string lowerTitle = toLowerCase(trimmed(title));
+        OperationTimer timer(Operation::PLAYLIST_SEARCH);
+        std::size_t maxDistance = lowerTitle.size() <= 4 ? 1 : lowerTitle.size() <= 8 ? 2 : 3;
+        buildFuzzyIndex();
+        struct Match {
+            std::size_t distance;
+            int rating;
+            SongId id;
+        };
+        std::vector<Match> matches;
+        fuzzyTitles.search(lowerTitle, maxDistance, [&](std::string_view text, std::size_t distance) {
+            const SongId* head = titleIndex.find(text);
+            if (!head) return; // no song has this title any more
+            for (SongId id = *head; id != kNoSong; id = sameTitleNext[id]) matches.push_back({ distance, ratingOf(id), id });
+        });
+        auto closer = [](const Match& a, const Match& b) {
+            if (a.distance != b.distance) return a.distance < b.distance;
+            return a.rating != b.rating ? a.rating > b.rating : a.id < b.id;
+        };
+        std::size_t kept = std::min(limit, matches.size());
+        std::partial_sort(matches.begin(), matches.begin() + kept, matches.end(), closer);
+        std::vector<SongId> ids;
+        ids.reserve(kept);
+        for (std::size_t i = 0; i < kept; ++i) ids.push_back(matches[i].id);
+        return ids;
+    }
+
+    // ids of songs whose artist contains the text (case-insensitive), ordered by id
+    std::vector<SongId> searchArtistIds(const std::string& artist) const {
+        std::string lowerArtist = toLowerCase(artist);
+        OperationTimer timer(Operation::PLAYLIST_SEARCH);
+        if (lowerArtist.empty()) return allIds();
+        buildSearchIndex();
+        return liveOnly(artistSearch.search(lowerArtist, [this](SongId id) { return strings.view(lowerArtists[id]); }));
+    }
+
+    // ids of every song, ordered by id
+    std::vector<SongId> allIds() const {
+        std::vector<SongId> ids;
+        ids.reserve(songCount);
+        for (SongId id = 0; id < ratings.size(); ++id)
+            if (isLive(id)) ids.push_back(id);
+        return ids;
+    }
+
+    // Search for a song by title
+    bool searchSong(const std::string& title) const {
+        return printMatches(searchTitleIds(title), "title", title);
+    }
+
+    // Search for songs by artist
+    bool searchArtist(const std::string& artist) const {
+        return printMatches(searchArtistIds(artist), "artist", artist);
+    }
+
+    // sort the songs by rating (high to low)
+    void sortByRating() {
+        OperationTimer timer(Operation::PLAYLIST_SORT);
+        // counting sort: the buckets already hold each rating's songs in playlist order, so
+        // relinking them from 5 stars down gives a stable sort in O(n) without comparisons
+        firstSong = lastSong = kNoSong;
+        for (int rating = kMaxRating; rating >= kMinRating; --rating)
+            for (SongId id = bucketFirst[rating]; id != kNoSong; id = bucketNext[id]) linkLast(id);
+        if (journal) journal->record(PlaylistJournal::RecordType::SORT);
+        if (verbose) std::cout << "Playlist sorted by rating (high to low).\n";
+    }
+
+    // sort the songs by rating (high to low), then by artist and title (A to Z, ignoring case);
+    // songs equal in all three keep their order; large playlists are sorted by several threads
+    void sortByRatingArtistTitle() {
+        OperationTimer timer(Operation::PLAYLIST_SORT);
+        // artists are interned, so the few distinct ones are ranked A to Z first and rating, artist and
+        // song id pack into one 64-bit entry; titles are only compared between songs of the same artist and rating
+        constexpr std::uint32_t kUnranked = 0xFFFFFFFFu;
+        std::vector<std::uint32_t> artistRank;  // lowercase artist's string id -> rank
+        std::vector<StringId> artistsByName;
+        for (SongId id = firstSong; id != kNoSong; id = nextSong[id]) {
+            StringId artist = lowerArtists[id];
+            if (artist >= artistRank.size()) artistRank.resize(std::max<std::size_t>(artist + 1, 2 * artistRank.size()), kUnranked);
+            if (artistRank[artist] == kUnranked) {
+                artistRank[artist] = 0;
+                artistsByName.push_back(artist);
+            }
+        }
+        std::sort(artistsByName.begin(), artistsByName.end(), [this](StringId a, StringId b) { return strings.view(a) < strings.view(b); });
+        for (std::size_t rank = 0; rank < artistsByName.size(); ++rank) artistRank[artistsByName[rank]] = std::uint32_t(rank);
+
+        // high 32 bits: 5 - rating above the artist rank (fits, there are fewer than 2^29 songs), low 32 bits: song id
+        std::vector<std::uint64_t> order;
+        order.reserve(songCount);
+        for (SongId id = firstSong; id != kNoSong; id = nextSong[id])
+            order.push_back((std::uint64_t(kMaxRating - ratings[id]) << 61 | std::uint64_t(artistRank[lowerArtists[id]]) << 32) | id);
+        parallelStableSort(order, [this](std::uint64_t a, std::uint64_t b) {
+            if ((a >> 32) != (b >> 32)) return (a >> 32) < (b >> 32);
+            return strings.view(lowerTitles[SongId(a)]) < strings.view(lowerTitles[SongId(b)]);
+        }, threads);
+        firstSong = lastSong = kNoSong;
+        for (std::uint64_t entry : order) linkLast(SongId(entry));
+        relinkBuckets();
+        if (journal) journal->record(PlaylistJournal::RecordType::SORT_ARTIST_TITLE);
+        if (verbose) std::cout << "Playlist sorted by rating, artist and title.\n";
+    }
+
+    // ids of the songs in playlist order
+    std::vector<SongId> orderIds() const {
+        std::vector<SongId> ids;
+        ids.reserve(songCount);
+        for (SongId id = firstSong; id != kNoSong; id = nextSong[id]) ids.push_back(id);
+        return ids;
+    }
+
+    // put the songs in this order (undo of a sort); songs missing from the list follow in their current
+    // order, and ids that are not in the playlist are skipped
+    void restoreOrder(const std::vector<SongId>& order) {
+        std::vector<SongId> current = orderIds();
+        std::vector<bool> placed(ratings.size());
+        firstSong = lastSong = kNoSong;
+        for (SongId id : order) {
+            if (!isLive(id) || placed[id]) continue;
+            placed[id] = true;
+            linkLast(id);
+        }
+        for (SongId id : current)
+            if (!placed[id]) linkLast(id);
+        relinkBuckets();
+        if (journal) journal->recordIds(PlaylistJournal::RecordType::ORDER, order);
+    }
+
+    // number of songs rated at least minRating, from the bucket counts
+    std::size_t countRatingAtLeast(int minRating) const {
+        std::size_t count = 0;
+        for (int rating = std::max(minRating, kMinRating); rating <= kMaxRating; ++rating) count += bucketCount[rating];
+        return count;
+    }
+
+    // ids of songs rated at least minRating, highest rating first and in playlist order within a rating
+    std::vector<SongId> songsRatedAtLeast(int minRating) const {
+        std::vector<SongId> ids;
+        ids.reserve(countRatingAtLeast(minRating));
+        for (int rating = kMaxRating; rating >= std::max(minRating, kMinRating); --rating)
+            for (SongId id = bucketFirst[rating]; id != kNoSong; id = bucketNext[id]) ids.push_back(id);
+        return ids;
+    }
+
+    // the k best-rated songs, in playlist order within a rating
+    std::vector<SongId> topSongIds(std::size_t k) const {
+        std::vector<SongId> ids;
+        ids.reserve(std::min(k, songCount));
+        for (int rating = kMaxRating; rating >= kMinRating && ids.size() < k; --rating)
+            for (SongId id = bucketFirst[rating]; id != kNoSong && ids.size() < k; id = bucketNext[id]) ids.push_back(id);
+        return ids;
+    }
+
+    // ids of an artist's songs (any case, surrounding spaces ignored), highest rating first and in the
+    // order they were added within a rating; only those songs are visited
+    std::vector<SongId> songsByArtist(const std::string& artist) const {
+        std::vector<SongId> ids;
+        const ArtistEntry* entry = findArtist(artist);
+        if (!entry) return ids;
+        ids.reserve(entry->songs);
+        for (int rating = kMaxRating; rating >= kMinRating; --rating)
+            for (SongId id = entry->first[rating]; id != kNoSong; id = artistNext[id]) ids.push_back(id);
+        return ids;
+    }
+
+    // number of songs by an artist, kept up to date by every add and remove
+    std::size_t artistSongCount(const std::string& artist) const {
+        const ArtistEntry* entry = findArtist(artist);
+        return entry ? entry->songs : 0;
+    }
+
+    // average rating of an artist's songs, 0 when there are none
+    double artistAverageRating(const std::string& artist) const {
+        const ArtistEntry* entry = findArtist(artist);
+        return entry ? double(entry->ratingTotal) / double(entry->songs) : 0.0;
+    }
+
+    // Display the songs of one artist, best rated first, with their count and average rating
+    void displayArtist(const std::string& artist) const {
+        const ArtistEntry* entry = findArtist(artist);
+        if (!entry) {
+            std::cout << "No songs by " << artist << " in the playlist.\n";
+            return;
+        }
+        std::ostringstream average;
+        average << std::fixed << std::setprecision(2) << double(entry->ratingTotal) / double(entry->songs);
+        std::cout << "Songs by " << trimmed(strings.view(entry->name)) << ": " << entry->songs
+            << (entry->songs == 1 ? " song" : " songs") << ", average rating " << average.str() << "/5\n";
+        printHeader();
+        printRows(songsByArtist(artist));
+    }
+
+    // Generate playlist based on rating preference
+    void generateTopPlaylist(int ratingWantToDisplay) {
+        std::cout << "Songs with rating >= " << ratingWantToDisplay << ":\n";
+        printHeader();
+       
+        // only the buckets with a rating >= rate you want to display are visited, best rating first
+        printRows(songsRatedAtLeast(ratingWantToDisplay));
+    }
+
+    // Display how many songs have each rating
+    void displayRatingHistogram() const {
+        std::cout << "********** RATING DISTRIBUTION **********\n";
+        std::size_t largest = 1;
+        for (int rating = kMinRating; rating <= kMaxRating; ++rating) largest = std::max(largest, bucketCount[rating]);
+        for (int rating = kMaxRating; rating >= kMinRating; --rating) {
+            std::size_t bar = bucketCount[rating] * 40 / largest; // longest bar is 40 characters
+            if (bar == 0 && bucketCount[rating] > 0) bar = 1;
+            std::cout << rating << "/5 | " << std::string(bar, '#') << std::string(40 - bar, ' ')
+                << " | " << bucketCount[rating] << "\n";
+        }
+        std::cout << "Total songs: " << songCount << "\n";
+    }
+
+    // find song by title (for undo action)
+    Song findSong(const std::string& title) const {
+        SongId id = findSlot(title);
+        if (id != kNoSong) return getSong(id);
+        return Song("", "", 0);  // Return empty song if not found
+    }
+
+    // bytes used to store the songs: columns plus the string pool (search indexes not included)
+    std::size_t memoryUsage() const {
+        return (titles.capacity() + artists.capacity() + lowerTitles.capacity() + lowerArtists.capacity()) * sizeof(StringId)
+            + ratings.capacity() * sizeof(std::uint8_t)
+            + (prevSong.capacity() + nextSong.capacity() + bucketPrev.capacity() + bucketNext.capacity()
+                + artistEntryOf.capacity() + artistPrev.capacity() + artistNext.capacity()
+                + freeSlots.capacity() + purgeSlots.capacity()) * sizeof(SongId)
+            + artistEntries.capacity() * sizeof(ArtistEntry) + artistIndex.memoryUsage()
+            + views[0].memoryUsage() + views[1].memoryUsage() + fuzzyTitles.memoryUsage()
+            + strings.memoryUsage();
+    }
+
+    // remove every song and reset the storage
+    void clear() {
+        strings.clear();
+        titles.clear();
+        artists.clear();
+        lowerTitles.clear();
+        lowerArtists.clear();
+        ratings.clear();
+        prevSong.clear();
+        nextSong.clear();
+        bucketPrev.clear();
+        bucketNext.clear();
+        artistEntries.clear();
+        artistIndex.clear();
+        artistEntryOf.clear();
+        artistPrev.clear();
+        artistNext.clear();
+        std::fill(std::begin(bucketFirst), std::end(bucketFirst), kNoSong);
+        std::fill(std::begin(bucketLast), std::end(bucketLast), kNoSong);
+        std::fill(std::begin(bucketCount), std::end(bucketCount), 0);
+        freeSlots.clear();
+        purgeSlots.clear();
+        firstSong = lastSong = kNoSong;
+        songCount = 0;
+        sameTitleNext.clear();
+        titleIndex.clear();
+        titleSearch.clear();
+        artistSearch.clear();
+        searchIndexed = true; // an empty index is complete, adds keep it current from here
+        for (std::size_t view = 0; view < 2; ++view) {
+            views[view].clear();
+            viewBuilt[view] = false;
+        }
+        fuzzyTitles.clear();
+        fuzzyIndexed = false;
+    }
+
+    // write each song as a "title,artist,rating" line, in playlist order (same format as Song::toString)
+    void writeText(std::ostream& out) const {
+        for (SongId id = firstSong; id != kNoSong; id = nextSong[id]) {
+            out << titleOf(id) << ',' << artistOf(id) << ',' << int(ratings[id]) << "\n";
+        }
+    }
+
+    // Save the playlist to a file
+    void saveToFile(const std::string& filename) const {
+        OperationTimer timer(Operation::PLAYLIST_SAVE);
+        std::ofstream outFile(filename); //ofstream	Creates and writes to files
+        if (!outFile) {                                             // from cppreferencce
+            std::cerr << "Error opening file for writing.\n";       //cerr means "character error (stream)"
+            return;                       //return if no found file
+        }
+        writeText(outFile);
+        if (operationStats.enabled()) operationStats.count(Counter::BYTES_WRITTEN, std::uint64_t(outFile.tellp()));
+        outFile.close();
+        std::cout << "Playlist saved to " << filename << "\n";
+    }
+
+    // Save the playlist in the binary format (see BinaryPlaylistHeader)
+    void saveToBinaryFile(const std::string& filename) const {
+        OperationTimer timer(Operation::PLAYLIST_SAVE);
+        BinaryPlaylistWriter writer;
+        writer.reserve(songCount);
+        for (SongId id = firstSong; id != kNoSong; id = nextSong[id])
+            writer.add(titleOf(id), artistOf(id), ratings[id]);
+        std::uint64_t written = writer.write(filename);
+        if (written == 0) {
+            std::cerr << "Error opening file for writing.\n";
+            return;
+        }
+        operationStats.count(Counter::BYTES_WRITTEN, written);
+        std::cout << "Playlist saved to " << filename << "\n";
+    }
+
+    // Load the playlist from a binary file, reading the songs straight from the mapped columns
+    void loadFromBinaryFile(const std::string& filename) {
+        OperationTimer timer(Operation::PLAYLIST_LOAD);
+        auto start = std::chrono::steady_clock::now();
+        BinaryPlaylistView view(filename);
+        if (!view.isValid()) {
+            std::cerr << "Error: " << filename << " is not a binary playlist.\n";
+            return;
+        }
+        operationStats.count(Counter::BYTES_READ, view.fileBytes());
+        clear();  // Clear the existing playlist
+        searchIndexed = false; // the search index is built in one go when it is first needed
+        reserve(view.size());
+        // artists are stored once in the file, so each is interned once and then reused by string number
+        std::vector<std::pair<StringId, StringId>> artistIds(view.stringCount(), { kNoSong, kNoSong });
+        for (std::size_t i = 0; i < view.size(); ++i) {
+            std::uint32_t number = view.artistNumber(i);
+            if (number >= artistIds.size()) continue; // damaged entry
+            if (artistIds[number].first == kNoSong) {
+                std::string_view artist = view.text(number);
+                StringId artistId = strings.intern(artist);
+                artistIds[number] = { artistId, fold(artist) == artist ? artistId : strings.intern(foldBuffer) };
+            }
+            insertSong(view.title(i), artistIds[number].first, artistIds[number].second, view.rating(i));
+        }
+        std::cout << "Playlist loaded from " << filename << ": " << songCount << " songs (" << elapsedMs(start) << " ms)\n";
+    }
+
+    // Load the playlist from a file
+    // the file is memory-mapped and split in place, storage is reserved from the line count,
+    // and one summary line is printed instead of one per song
+    void loadFromFile(const std::string& filename) {
+        OperationTimer timer(Operation::PLAYLIST_LOAD);
+        auto start = std::chrono::steady_clock::now();
+        MappedFile file(filename);
+        if (!file.isOpen()) {
+            std::cerr << "Error opening file for reading.\n";        //cerr means "character error (stream)"
+            return;
+        }
+        operationStats.count(Counter::BYTES_READ, file.data().size());
+        clear();  // Clear the existing playlist
+        searchIndexed = false; // the search index is built in one go when it is first needed
+        // lines are split and lowercased by several threads, then stored here in file order
+        std::vector<ParsedSongs> parsed = parseSongLinesParallel(file.data(), threads);
+        std::size_t lines = 0, skipped = 0;
+        for (const ParsedSongs& piece : parsed) lines += piece.lines.size();
+        reserve(lines);
+        for (const ParsedSongs& piece : parsed) {
+            for (const ParsedSongs::Line& line : piece.lines) {
+                StringId artistId = strings.intern(line.fields.artist);
+                StringId lowerArtistId = line.lowerArtist == line.fields.artist ? artistId : strings.intern(line.lowerArtist);
+                insertSong(line.fields.title, line.lowerTitle, artistId, lowerArtistId, line.fields.rating);
+            }
+            skipped += piece.skipped;
+        }
+        std::cout << "Playlist loaded from " << filename << ": " << songCount << " songs";
+        if (skipped > 0) std::cout << ", " << skipped << " unreadable lines skipped";
+        std::cout << " (" << elapsedMs(start) << " ms)\n"; 
+    }
+
+    // Add the songs of a file after the current ones, returns their ids (one summary line is printed)
+    std::vector<SongId> importFromFile(const std::string& filename) {
+        OperationTimer timer(Operation::PLAYLIST_LOAD);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<SongId> added;
+        MappedFile file(filename);
+        if (!file.isOpen()) {
+            std::cerr << "Error opening file for reading.\n";
+            return added;
+        }
+        std::string_view data = file.data();
+        operationStats.count(Counter::BYTES_READ, data.size());
+        std::size_t lines = std::size_t(std::count(data.begin(), data.end(), '\n')) + 1;
+        if (lines > songCount) deferSearchIndex(); // rebuilding once is cheaper than growing a small index line by line
+        reserve(ratings.size() + lines);
+        added.reserve(lines);
+        std::size_t skipped = forEachSongLine(data, [&](const SongFields& fields) {
+            SongId id = insertSong(fields.title, fields.artist, fields.rating);
+            if (journal) journal->record(PlaylistJournal::RecordType::ADD, id, titleOf(id), artistOf(id), ratings[id]);
+            added.push_back(id);
+        });
+        operationStats.count(Counter::SONGS_ADDED, added.size());
+        std::cout << "Imported " << added.size() << " songs from " << filename;
+        if (skipped > 0) std::cout << ", " << skipped << " unreadable lines skipped";
+        std::cout << " (" << elapsedMs(start) << " ms)\n";
+        return added;
+    }
+};
+
+// UndoStack class managing undo and redo operations
+// a command log: edits made through it are applied to the playlist and logged as 8-byte UndoActions
+// naming the song by id; removed songs keep their slot (Playlist::retireSong) while the log can still
+// bring them back, so undo and redo relink that exact song in O(1) instead of searching by title
+// edits between beginGroup() and endGroup() (an import) are undone and redone as one step, a sort is
+// one step that saves the order it replaced, and the oldest steps are dropped past the history limit
+class UndoStack {
+private:
+    Playlist& playlist;  //refrence to the playlist to modify it during undo/redo
+    RingBuffer<UndoAction> actions;  // oldest first: [0, cursor) can be undone, [cursor, end) redone
+    std::size_t cursor = 0;
+    std::deque<std::vector<SongId>> savedOrders; // order before each sort action, in the same sequence
+    std::size_t ordersBeforeCursor = 0;          // sort actions in [0, cursor)
+    std::size_t historySize = 0;     // actions plus the ids in saved orders
+    std::size_t historyLimit;
+    int openGroups = 0;
+    bool groupStarted = false;
+    bool verbose = true;             // print what undo and redo did
+
+    std::size_t weightOf(const UndoAction& action, const std::vector<SongId>* order) const {
+        return 1 + (action.isSort() ? order->size() : 0);
+    }
+
+    // drop the redo part: its removed songs can no longer come back
+    void dropRedo() {
+        while (actions.size() > cursor) {
+            const UndoAction& action = actions.back();
+            if (action.isSort()) {
+                historySize -= weightOf(action, &savedOrders.back());
+                savedOrders.pop_back();
+            }
+            else {
+                if (action.actionType == UndoAction::ActionType::ADD) playlist.releaseSong(action.song); // an undone add
+                historySize -= 1;
+            }
+            actions.pop_back();
+        }
+    }
+
+    // drop the oldest steps while the history is over its limit; only steps that can be undone are
+    // dropped, and the newest of them always stays
+    void trimHistory() {
+        while (historySize > historyLimit) {
+            std::size_t groupEnd = 1;
+            while (groupEnd < cursor && !actions[groupEnd].startsGroup) ++groupEnd;
+            if (groupEnd >= cursor) return; // only the newest step is left
+            for (std::size_t i = 0; i < groupEnd; ++i) {
+                const UndoAction& action = actions.front();
+                if (action.isSort()) {
+                    historySize -= weightOf(action, &savedOrders.front());
+                    savedOrders.pop_front();
+                    --ordersBeforeCursor;
+                }
+                else {
+                    if (action.actionType == UndoAction::ActionType::REMOVE) playlist.releaseSong(action.song);
+                    historySize -= 1;
+                }
+                actions.pop_front();
+                --cursor;
+            }
+        }
+    }
+
+    // log an edit that was just applied
+    void record(UndoAction::ActionType type, SongId id, std::vector<SongId>* order = nullptr) {
+        dropRedo();
+        bool first = openGroups == 0 || !groupStarted;
+        if (openGroups > 0) groupStarted = true;
+        actions.emplace_back(type, id, first);
+        if (order) {
+            savedOrders.push_back(std::move(*order));
+            ++ordersBeforeCursor;
+        }
+        historySize += weightOf(actions.back(), order ? &savedOrders.back() : nullptr);
+        ++cursor;
+        trimHistory();
+    }
+
+public:
+    static constexpr std::size_t kDefaultHistoryLimit = 100000;
+
+    // Constructor that takes playlist by reference to modify it
+    explicit UndoStack(Playlist& p, std::size_t limit = kDefaultHistoryLimit) : playlist(p), historyLimit(limit) {}
+
+    ~UndoStack() { clear(); }
+
+    // turn the undo and redo messages on or off
+    void setVerbose(bool on) { verbose = on; }
+
+    // how many actions (plus saved order entries) the history may hold
+    // a history over the new limit loses its redo part first, then its oldest steps
+    void setHistoryLimit(std::size_t limit) {
+        historyLimit = limit;
+        if (historySize > historyLimit) dropRedo();
+        trimHistory();
+    }
+
+    // add a song and log it
+    SongId addSong(const Song& song) {
+        SongId id = playlist.addSong(song);
+        record(UndoAction::ActionType::ADD, id);
+        return id;
+    }
+
+    // remove the oldest song with this title and log it, returns false if there is none
+    bool removeSong(const std::string& title) {
+        SongId id = playlist.findSongId(title);
+        if (id == kNoSong) {
+            if (playlist.isVerbose()) std::cout << "Song '" << title << "' not found in the playlist.\n";
+            return false;
+        }
+        playlist.retireSong(id);
+        record(UndoAction::ActionType::REMOVE, id);
+        return true;
+    }
+
+    // sort the playlist by rating, undone in one step by putting the previous order back
+    void sortByRating() {
+        std::vector<SongId> order = playlist.orderIds();
+        playlist.sortByRating();
+        record(UndoAction::ActionType::SORT, kNoSong, &order);
+    }
+
+    // sort by rating, artist and title, undone the same way
+    void sortByRatingArtistTitle() {
+        std::vector<SongId> order = playlist.orderIds();
+        playlist.sortByRatingArtistTitle();
+        record(UndoAction::ActionType::SORT_ARTIST_TITLE, kNoSong, &order);
+    }
+
+    // add the songs of a file as one step, returns how many were added
+    std::size_t importFromFile(const std::string& filename) {
+        std::vector<SongId> added = playlist.importFromFile(filename);
+        beginGroup();
+        for (SongId id : added) record(UndoAction::ActionType::ADD, id);
+        endGroup();
+        return added.size();
+    }
+
+    // edits logged until the matching endGroup are undone and redone together
+    void beginGroup() {
+        if (openGroups++ == 0) groupStarted = false;
+    }
+    void endGroup() {
+        if (openGroups > 0) --openGroups;
+    }
+
+    // Undo the last step
+    void undoAction() {
+        OperationTimer timer(Operation::UNDO);
+        if (cursor == 0) {
+            if (verbose) std::cout << "No actions to undo.\n";
+            return;
+        }
+        std::size_t begin = cursor - 1;
+        while (!actions[begin].startsGroup) --begin;
+        bool single = cursor - begin == 1;
+        bool wasVerbose = playlist.isVerbose();
+        if (!single) playlist.setVerbose(false); // one line for the whole group
+        for (std::size_t i = cursor; i-- > begin;) {
+            const UndoAction& lastAction = actions[i];
+            // Undo based on the action type
+            if (lastAction.actionType == UndoAction::ActionType::ADD) {
+                playlist.retireSong(lastAction.song);
+            }
+            else if (lastAction.actionType == UndoAction::ActionType::REMOVE) {
+                playlist.restoreSong(lastAction.song);
+                if (verbose && single) std::cout << "Restored song: " << playlist.titleOf(lastAction.song) << "\n";
+            }
+            else {
+                playlist.restoreOrder(savedOrders[--ordersBeforeCursor]);
+                if (verbose && single) std::cout << "Playlist order restored.\n";
+            }
+        }
+        playlist.setVerbose(wasVerbose);
+        if (verbose && !single) std::cout << "Undid " << cursor - begin << " changes.\n";
+        cursor = begin;
+    }
+
+    // Redo the last undone step
+    void redoAction() {
+        OperationTimer timer(Operation::REDO);
+        if (cursor == actions.size()) {
+            if (verbose) std::cout << "No actions to redo.\n";
+            return;
+        }
+        std::size_t end = cursor + 1;
+        while (end < actions.size() && !actions[end].startsGroup) ++end;
+        bool single = end - cursor == 1;
+        bool wasVerbose = playlist.isVerbose();
+        if (!single) playlist.setVerbose(false);
+        for (std::size_t i = cursor; i < end; ++i) {
+            const UndoAction& lastAction = actions[i];
+            // Redo based on the action type
+            if (lastAction.actionType == UndoAction::ActionType::ADD) {
+                playlist.restoreSong(lastAction.song);
+                if (verbose && single) std::cout << "Restored song: " << playlist.titleOf(lastAction.song) << "\n";
+            }
+            else if (lastAction.actionType == UndoAction::ActionType::REMOVE) {
+                playlist.retireSong(lastAction.song);
+            }
+            else {
+                // same order as the first time, from the same starting order
+                if (lastAction.actionType == UndoAction::ActionType::SORT) playlist.sortByRating();
+                else playlist.sortByRatingArtistTitle();
+                ++ordersBeforeCursor;
+            }
+        }
+        playlist.setVerbose(wasVerbose);
+        if (verbose && !single) std::cout << "Redid " << end - cursor << " changes.\n";
+        cursor = end;
+    }
+
+    // forget the whole history (before the playlist is replaced by a load)
+    void clear() {
+        dropRedo();
+        while (!actions.empty()) {
+            if (actions.back().actionType == UndoAction::ActionType::REMOVE) playlist.releaseSong(actions.back().song);
+            actions.pop_back();
+        }
+        savedOrders.clear();
+        cursor = ordersBeforeCursor = historySize = 0;
+    }
+
+    // bytes held by the history
+    std::size_t memoryUsage() const {
+        std::size_t bytes = actions.capacity() * sizeof(UndoAction);
+        for (const std::vector<SongId>& order : savedOrders) bytes += order.capacity() * sizeof(SongId);
+        return bytes;
+    }
+};
+// Priority Queue for managing songs sorted by rating
+// an indexed binary max-heap: every song knows its heap position, so a song can be found by title,
+// removed or re-rated in O(log n), and the top K are read in place without copying the whole heap
+class SongPriorityQueue {
+private:
+    std::vector<Song> entries;               // slot -> song
+    std::vector<std::uint64_t> addedOrder;   // slot -> insertion number, breaks rating ties (older first)
+    std::vector<std::size_t> heap;           // max-heap of slots, best song at heap[0]
+    std::vector<std::size_t> heapPos;        // slot -> its position in heap
+    std::vector<std::size_t> freeEntries;    // slots left behind by removed songs
+    // trimmed lowercase title -> oldest slot with that title; later ones are chained through sameTitleNext
+    std::unordered_map<std::string, std::size_t> byTitle;
+    std::vector<std::size_t> sameTitleNext;  // slot -> next (newer) slot with the same title
+    static constexpr std::size_t kNoSlot = SIZE_MAX;
+    std::uint64_t nextOrder = 0;
+    std::size_t threads = 0;                 // worker threads for loading files (0: one per core)
+    MergePolicy mergePolicy = MergePolicy::KEEP_LAST; // rating a song keeps when it is added again
+    //helper tomlower ffunction for the case sensitive
+    std::string toLowerCase(const std::string& str) const {
+        std::string lowerStr = str;
+        std::transform(lowerStr.begin(), lowerStr.end(), lowerStr.begin(), ::tolower);
+        return lowerStr;
+    }
+
+    // the byTitle key of a title: spaces around it and case do not count
+    std::string titleKey(std::string_view title) const {
+        return toLowerCase(std::string(trimmed(title)));
+    }
+
+    // true when slot a should be above slot b: higher rating first, then the one added earlier
+    bool ranksAbove(std::size_t a, std::size_t b) const {
+        if (entries[a].rating != entries[b].rating) return entries[a].rating > entries[b].rating;
+        return addedOrder[a] < addedOrder[b];
+    }
+
+    void placeAt(std::size_t pos, std::size_t slot) {
+        heap[pos] = slot;
+        heapPos[slot] = pos;
+    }
+
+    void siftUp(std::size_t pos) {
+        std::size_t slot = heap[pos];
+        while (pos > 0) {
+            std::size_t parent = (pos - 1) / 2;
+            if (!ranksAbove(slot, heap[parent])) break;
+            placeAt(pos, heap[parent]);
+            pos = parent;
+        }
+        placeAt(pos, slot);
+    }
+
+    void siftDown(std::size_t pos) {
+        std::size_t slot = heap[pos];
+        for (;;) {
+            std::size_t child = 2 * pos + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && ranksAbove(heap[child + 1], heap[child])) ++child;
+            if (!ranksAbove(heap[child], slot)) break;
+            placeAt(pos, heap[child]);
+            pos = child;
+        }
+        placeAt(pos, slot);
+    }
+
+    // re-rate the song in a slot and move it to its new place in the heap
+    void rerateSlot(std::size_t slot, int rating) {
+        entries[slot].rating = std::clamp(rating, kMinRating, kMaxRating); // pinned to 1..5, as the playlist does
+        siftUp(heapPos[slot]);
+        siftDown(heapPos[slot]);
+    }
+
+    // slot of the oldest song with this title (case-insensitive), or entries.size() if none
+    std::size_t findSlot(const std::string& title) const {
+        auto found = byTitle.find(titleKey(title));
+        return found == byTitle.end() ? entries.size() : found->second;
+    }
+
+    // slot holding the same title and artist (case and surrounding spaces ignored, as songKey does),
+    // or entries.size() if none
+    std::size_t findDuplicate(const Song& song) const {
+        return findDuplicate(song, titleKey(song.title));
+    }
+
+    // same, with the title key already worked out
+    std::size_t findDuplicate(const Song& song, const std::string& key) const {
+        auto found = byTitle.find(key);
+        if (found != byTitle.end()) {
+            std::string_view artist = trimmed(song.artist);
+            for (std::size_t slot = found->second; slot != kNoSlot; slot = sameTitleNext[slot])
+                if (equalsIgnoreCase(trimmed(entries[slot].artist), artist)) return slot;
+        }
+        return entries.size();
+    }
+
+    // store a song that is not queued yet in a slot and index its title, without placing it in the heap
+    std::size_t storeSong(Song&& song) {
+        std::string key = titleKey(song.title);
+        return storeSong(std::move(song), std::move(key));
+    }
+
+    // same, with the title key already worked out
+    std::size_t storeSong(Song&& song, std::string&& key) {
+        song.rating = std::clamp(song.rating, kMinRating, kMaxRating);
+        std::size_t slot;
+        if (!freeEntries.empty()) {
+            slot = freeEntries.back();
+            freeEntries.pop_back();
+            entries[slot] = std::move(song);
+        }
+        else {
+            slot = entries.size();
+            entries.push_back(std::move(song));
+            addedOrder.push_back(0);
+            heapPos.push_back(0);
+            sameTitleNext.push_back(kNoSlot);
+        }
+        addedOrder[slot] = nextOrder++;
+        sameTitleNext[slot] = kNoSlot;
+        auto inserted = byTitle.emplace(std::move(key), slot);
+        if (!inserted.second) { // append to the chain so the oldest stays first
+            std::size_t last = inserted.first->second;
+            while (sameTitleNext[last] != kNoSlot) last = sameTitleNext[last];
+            sameTitleNext[last] = slot;
+        }
+        return slot;
+    }
+
+    // print the table header used by the queue listing
+    void printHeader() const {
+        std::cout << std::setw(35) << std::left << "TITLE"
+            << std::setw(20) << std::left << "ARTIST"
+            << std::setw(10) << std::right << "RATING\n";
+        std::cout << std::setfill('-') << std::setw(65) << "" << std::setfill(' ') << '\n';  
+    }
+
+public:
+   
+    //  function to save a song to the text file
+    // only for songs addSong reported as new: a song already queued is settled by rewriting the file
+    // with saveToFile, so songs.txt does not collect a line per re-add
+    void saveSongToFile(const Song& song) {
+        OperationTimer timer(Operation::QUEUE_SAVE);
+        std::ofstream outFile("songs.txt", std::ios::app); 
+        if (!outFile) {
+            std::cerr << "Error opening file for writing.\n";
+            return;
+        }
+
+        std::string line = song.toString();
+        outFile << line << "\n"; 
+        operationStats.count(Counter::BYTES_WRITTEN, line.size() + 1);
+        outFile.close();
+        std::cout << "Song saved to 'songs.txt'.\n";
+    }
+
+    // rewrite the whole queue to a file, best songs first (after removes and re-rates)
+    void saveToFile(const std::string& filename) const {
+        OperationTimer timer(Operation::QUEUE_SAVE);
+        std::ofstream outFile(filename);
+        if (!outFile) {
+            std::cerr << "Error opening file for writing.\n";
+            return;
+        }
+        forEachTop(heap.size(), [&](const Song& s) { outFile << s.toString() << "\n"; });
+        if (operationStats.enabled()) operationStats.count(Counter::BYTES_WRITTEN, std::uint64_t(outFile.tellp()));
+        outFile.close();
+        std::cout << "Priority queue saved to " << filename << "\n";
+    }
+
+    // add every song of a file to the queue
+    // the file is memory-mapped and split in place, the songs are stored first and the heap is built
+    // once at the end (O(n) instead of one sift per song), and one summary line is printed
+    // large files are parsed into songs by several threads; they are queued here in file order
+    // a song already queued is never queued twice: its copies are merged by the merge policy
+    // returns how many lines were merged that way (the file holds duplicates when it is not 0)
+    std::size_t loadFromFile(const std::string& filename) {
+        OperationTimer timer(Operation::QUEUE_LOAD);
+        auto start = std::chrono::steady_clock::now();
+        MappedFile file(filename);
+        if (!file.isOpen()) {
+            std::cerr << "Error opening file for reading.\n";       
+            return 0;
+        }
+        std::string_view data = file.data();
+        operationStats.count(Counter::BYTES_READ, data.size());
+        std::size_t lines = std::size_t(std::count(data.begin(), data.end(), '\n')) + 1;
+        entries.reserve(entries.size() + lines);
+        addedOrder.reserve(addedOrder.size() + lines);
+        heapPos.reserve(heapPos.size() + lines);
+        heap.reserve(heap.size() + lines);
+        sameTitleNext.reserve(sameTitleNext.size() + lines);
+        byTitle.reserve(byTitle.size() + lines);
+
+        std::vector<ParsedSongs> parsed = parseSongLinesParallel(data, threads);
+        std::vector<std::vector<Song>> songs(parsed.size());
+        std::vector<std::vector<std::string>> titleKeys(parsed.size());
+        runParallel(parsed.size(), [&](std::size_t part) {
+            songs[part].reserve(parsed[part].lines.size());
+            titleKeys[part].reserve(parsed[part].lines.size());
+            for (const ParsedSongs::Line& line : parsed[part].lines) {
+                songs[part].emplace_back(std::string(line.fields.title), std::string(line.fields.artist), line.fields.rating);
+                titleKeys[part].emplace_back(trimmed(line.lowerTitle));
+            }
+        });
+
+        std::size_t added = 0, merged = 0, skipped = 0;
+        for (std::size_t part = 0; part < parsed.size(); ++part) {
+            for (std::size_t i = 0; i < songs[part].size(); ++i) {
+                Song& song = songs[part][i];
+                std::size_t duplicate = findDuplicate(song, titleKeys[part][i]);
+                if (duplicate != entries.size()) { // already queued: the heap is rebuilt below
+                    entries[duplicate].rating = mergeRating(mergePolicy, entries[duplicate].rating, std::clamp(song.rating, kMinRating, kMaxRating));
+                    ++merged;
+                    continue;
+                }
+                heap.push_back(storeSong(std::move(song), std::move(titleKeys[part][i])));
+                ++added;
+            }
+            skipped += parsed[part].skipped;
+        }
+
+        // bottom-up heap construction over every queued slot
+        for (std::size_t pos = 0; pos < heap.size(); ++pos) heapPos[heap[pos]] = pos;
+        for (std::size_t pos = heap.size() / 2; pos-- > 0;) siftDown(pos);
+
+        std::cout << "Priority queue loaded from " << filename << ": " << added << " songs";
+        if (merged > 0) std::cout << ", " << merged << " duplicates merged";
+        if (skipped > 0) std::cout << ", " << skipped << " unreadable lines skipped";
+        std::cout << " (" << elapsedMs(start) << " ms)\n"; 
+        return merged;
+    }
+
+    std::size_t size() const { return heap.size(); }
+
+    // worker threads for loading large files (0: one per core)
+    void setThreads(std::size_t count) { threads = count; }
+
+    // how addSong and loadFromFile settle the rating of a song that is already queued
+    void setMergePolicy(MergePolicy policy) { mergePolicy = policy; }
+   
+    //Function to Add Song to the priorityqueue
+    // a song already in the queue (same title and artist) is not added twice, it takes the new rating instead
+    // returns false when the song was a duplicate
+    bool addSong(const Song& song) {
+        OperationTimer timer(Operation::QUEUE_ADD);
+        std::size_t duplicate = findDuplicate(song);
+        if (duplicate != entries.size()) {
+            int rating = mergeRating(mergePolicy, entries[duplicate].rating, song.rating);
+            if (entries[duplicate].rating != rating) rerateSlot(duplicate, rating);
+            return false;
+        }
+        std::size_t slot = storeSong(Song(song));
+        heap.push_back(slot);
+        heapPos[slot] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+        return true;
+    }
+
+    // remove the oldest song with this title, returns false if there is none
+    bool removeSong(const std::string& title) {
+        OperationTimer timer(Operation::QUEUE_REMOVE);
+        std::size_t slot = findSlot(title);
+        if (slot == entries.size()) return false;
+        auto head = byTitle.find(titleKey(entries[slot].title)); // slot is the oldest of its title
+        if (sameTitleNext[slot] == kNoSlot) byTitle.erase(head);
+        else head->second = sameTitleNext[slot];
+
+        // move the last heap element into the hole and restore the heap from there
+        std::size_t pos = heapPos[slot];
+        std::size_t last = heap.back();
+        heap.pop_back();
+        if (pos < heap.size()) {
+            placeAt(pos, last);
+            siftUp(pos);
+            siftDown(heapPos[last]);
+        }
+        entries[slot] = Song("", "", 0);
+        freeEntries.push_back(slot);
+        return true;
+    }
+
+    // give the oldest song with this title a new rating, returns false if there is none
+    bool updateRating(const std::string& title, int rating) {
+        std::size_t slot = findSlot(title);
+        if (slot == entries.size()) return false;
+        rerateSlot(slot, rating);
+        return true;
+    }
+
+    // call fn on the k best songs in order, without copying or popping the heap:
+    // a small frontier heap of candidate positions grows by the two children of each visited node
+    // (when most of the queue is wanted, sorting a copy of the slot numbers is cheaper than the frontier)
+    template <typename Fn>
+    void forEachTop(std::size_t k, Fn fn) const {
+        if (heap.empty() || k == 0) return;
+        OperationTimer timer(Operation::QUEUE_TOP);
+        k = std::min(k, heap.size());
+        if (k > heap.size() / 8) {
+            operationStats.count(Counter::QUEUE_ENTRIES_COPIED, heap.size());
+            struct Ranked { int rating; std::uint64_t added; std::size_t slot; };
+            std::vector<Ranked> order;
+            order.reserve(heap.size());
+            for (std::size_t slot : heap) order.push_back({ entries[slot].rating, addedOrder[slot], slot });
+            auto above = [](const Ranked& a, const Ranked& b) {
+                return a.rating != b.rating ? a.rating > b.rating : a.added < b.added;
+            };
+            if (k == order.size()) std::sort(order.begin(), order.end(), above);
+            else std::partial_sort(order.begin(), order.begin() + k, order.end(), above);
+            for (std::size_t i = 0; i < k; ++i) fn(entries[order[i].slot]);
+            return;
+        }
+        auto lower = [this](std::size_t a, std::size_t b) { return ranksAbove(heap[b], heap[a]); };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(lower)> frontier(lower);
+        frontier.push(0);
+        std::size_t visited = 0;
+        for (; visited < k && !frontier.empty(); ++visited) {
+            std::size_t pos = frontier.top();
+            frontier.pop();
+            fn(entries[heap[pos]]);
+            if (2 * pos + 1 < heap.size()) frontier.push(2 * pos + 1);
+            if (2 * pos + 2 < heap.size()) frontier.push(2 * pos + 2);
+        }
+        operationStats.count(Counter::QUEUE_ENTRIES_COPIED, visited + frontier.size()); // every position pushed
+    }
+
+    // the k best songs, highest rating first
+    std::vector<Song> topK(std::size_t k) const {
+        std::vector<Song> top;
+        top.reserve(std::min(k, heap.size()));
+        forEachTop(k, [&](const Song& s) { top.push_back(s); });
+        return top;
+    }
+    
+    // function to display the top songs in the priority queue
+    void displayTopSongs() const {
+        if (heap.empty()) { 
+            std::cout << "No songs in the priority queue.\n";
+            return; // exit the function
+        }
+
+        std::cout << "********** Top rated songs in priority queue **********\n";
+        printHeader();
+        forEachTop(heap.size(), [](const Song& s) {
+            // print the song title, artist, and rating to the console
+            std::cout << std::setw(35) << std::left << s.title  
+                << std::setw(20) << std::left << s.artist
+                << std::setw(5) << std::right << "[ " << s.rating << "/5 ] \n";
+        });
+    }
+};
+
+// Weighted shuffle for playback
+// picks songs of a playlist at random, each with a chance proportional to its rating, and never plays
+// two songs of the same artist back to back (unless the playlist has a single artist)
+// the songs are grouped by artist: a pick first chooses an artist by its total rating, leaving out the
+// range of the artist just played, with a binary search over the running totals (O(log a) for a artists),
+// then a song of that artist through the artist's own alias table (Vose), one random slot and one coin
+// flip; so each song other than the last artist's comes up in proportion to its rating, an endless queue
+// is produced one song at a time and nothing is stored per song played
+// the shuffle works on the songs the playlist held when it was built: call rebuild() after editing it
+class ShuffleQueue {
+private:
+    const Playlist& playlist;
+    std::vector<SongId> ids;                 // pick -> song, grouped by artist
+    std::vector<std::uint64_t> threshold;    // pick i keeps itself when a draw in [0, its artist's weight) is below this
+    std::vector<std::uint32_t> alias;        // pick -> the pick of the same artist used otherwise
+    std::vector<std::uint32_t> artistFirst;  // artist group -> its first pick; one more entry ends the last group
+    std::vector<std::uint64_t> weightBefore; // artist group -> total rating of the groups before it; one more entry
+    std::uint32_t lastArtist = 0;            // group of the song played last
+    bool played = false;                     // false until the first song, which may be any artist
+    std::mt19937_64 rng;
+
+    std::uint64_t weightOf(std::uint32_t group) const { return weightBefore[group + 1] - weightBefore[group]; }
+
+public:
+    explicit ShuffleQueue(const Playlist& source, std::uint64_t seed = std::random_device{}())
+        : playlist(source), rng(seed) {
+        rebuild();
+    }
+
+    // build the tables from the playlist as it is now; weights are whole ratings, so the tables are exact
+    void rebuild() {
+        std::vector<SongId> songs = playlist.allIds();
+        std::size_t n = songs.size();
+        // group the songs by artist number, keeping playlist order within an artist
+        std::vector<std::uint32_t> groupOf;      // artist number -> group + 1, 0 while unseen
+        std::vector<std::uint32_t> groupSize;
+        for (SongId id : songs) {
+            std::uint32_t artist = playlist.artistNumberOf(id);
+            if (artist >= groupOf.size()) groupOf.resize(std::max<std::size_t>(artist + 1, 2 * groupOf.size()), 0);
+            if (groupOf[artist] == 0) {
+                groupSize.push_back(0);
+                groupOf[artist] = std::uint32_t(groupSize.size());
+            }
+            ++groupSize[groupOf[artist] - 1];
+        }
+        std::size_t groups = groupSize.size();
+        artistFirst.assign(groups + 1, 0);
+        for (std::size_t g = 0; g < groups; ++g) artistFirst[g + 1] = artistFirst[g] + groupSize[g];
+        ids.resize(n);
+        std::vector<std::uint32_t> fill(artistFirst.begin(), artistFirst.end() - 1);
+        for (SongId id : songs) ids[fill[groupOf[playlist.artistNumberOf(id)] - 1]++] = id;
+
+        threshold.resize(n);
+        alias.resize(n);
+        weightBefore.assign(groups + 1, 0);
+        std::vector<std::uint32_t> small, large;
+        for (std::size_t g = 0; g < groups; ++g) {
+            std::uint32_t first = artistFirst[g], end = artistFirst[g + 1];
+            std::uint64_t m = end - first, weight = 0;
+            for (std::uint32_t i = first; i < end; ++i) weight += std::uint64_t(playlist.ratingOf(ids[i]));
+            weightBefore[g + 1] = weightBefore[g] + weight;
+            // scaled weight m * w against the artist's total: below it a pick is "small" and borrows the
+            // rest of its slot from a "large" one
+            small.clear();
+            large.clear();
+            for (std::uint32_t i = first; i < end; ++i) {
+                alias[i] = i;
+                threshold[i] = std::uint64_t(playlist.ratingOf(ids[i])) * m;
+                (threshold[i] < weight ? small : large).push_back(i);
+            }
+            while (!small.empty() && !large.empty()) {
+                std::uint32_t less = small.back(), more = large.back();
+                small.pop_back();
+                alias[less] = more;
+                threshold[more] -= weight - threshold[less];
+                if (threshold[more] < weight) {
+                    large.pop_back();
+                    small.push_back(more);
+                }
+            }
+            // the weights are whole numbers, so whatever is left is exactly full
+            for (std::uint32_t i : large) threshold[i] = weight;
+            for (std::uint32_t i : small) threshold[i] = weight;
+        }
+        played = false;
+    }
+
+    std::size_t size() const { return ids.size(); }
+
+    // the next song to play (kNoSong when the playlist was empty)
+    SongId next() {
+        if (ids.empty()) return kNoSong;
+        std::size_t groups = artistFirst.size() - 1;
+        // a draw over every weight but the last artist's, stepped over that artist's range
+        bool skipLast = played && groups > 1;
+        std::uint64_t total = weightBefore[groups] - (skipLast ? weightOf(lastArtist) : 0);
+        std::uint64_t draw = std::uniform_int_distribution<std::uint64_t>(0, total - 1)(rng);
+        if (skipLast && draw >= weightBefore[lastArtist]) draw += weightOf(lastArtist);
+        std::uint32_t group = std::uint32_t(std::upper_bound(weightBefore.begin() + 1, weightBefore.end(), draw) - weightBefore.begin() - 1);
+        // then a song of that artist
+        std::uint32_t first = artistFirst[group], end = artistFirst[group + 1];
+        std::uint32_t i = first + std::uint32_t(std::uniform_int_distribution<std::uint32_t>(0, end - first - 1)(rng));
+        std::uint32_t pick = std::uniform_int_distribution<std::uint64_t>(0, weightOf(group) - 1)(rng) < threshold[i] ? i : alias[i];
+        lastArtist = group;
+        played = true;
+        return ids[pick];
+    }
+
+    // the next count songs
+    std::vector<SongId> take(std::size_t count) {
+        std::vector<SongId> queue;
+        queue.reserve(count);
+        for (std::size_t i = 0; i < count && !ids.empty(); ++i) queue.push_back(next());
+        return queue;
+    }
+};
+
+// "--shuffle <file> [count] [--seed N]": write count shuffled songs of a playlist file (text or .mplb) to
+// stdout as file lines, or an endless stream when count is 0 (until the reader closes it); the songs are
+// picked one at a time as they are written
+bool streamShuffle(const std::string& filename, std::size_t count, std::uint64_t seed) {
+    Playlist playlist;
+    playlist.setVerbose(false);
+    std::streambuf* songsOut = std::cout.rdbuf(std::cerr.rdbuf()); // the load summary goes to stderr
+    if (filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".mplb") == 0) playlist.loadFromBinaryFile(filename);
+    else playlist.loadFromFile(filename);
+    std::cout.rdbuf(songsOut);
+    if (playlist.size() == 0) {
+        std::cerr << "No songs to shuffle in " << filename << ".\n";
+        return false;
+    }
+    ShuffleQueue shuffle(playlist, seed);
+    std::string buffer;
+    for (std::size_t played = 0; count == 0 || played < count; ++played) {
+        SongId id = shuffle.next();
+        std::string_view title = playlist.titleOf(id), artist = playlist.artistOf(id);
+        buffer.append(title.data(), title.size());
+        buffer += ',';
+        buffer.append(artist.data(), artist.size());
+        buffer += ',';
+        buffer += char('0' + playlist.ratingOf(id));
+        buffer += '\n';
+        if (buffer.size() >= (1 << 16)) {
+            if (!std::cout.write(buffer.data(), std::streamsize(buffer.size()))) return true; // reader went away
+            buffer.clear();
+        }
+    }
+    std::cout.write(buffer.data(), std::streamsize(buffer.size()));
+    std::cout.flush();
+    return true;
+}
+
+// ---------- Song catalog ----------
+
+// Songs stored once and shared by any number of named playlists and priority queues
+// a song (title and artist, case and surrounding spaces ignored, as songKey matches them) lives in one
+// slot of columns like Playlist's, and the lists hold its 4-byte id, so a song on five lists is one copy
+// of its text and five ids; a slot counts the list entries using it and is freed with the last one
+// the rating belongs to the song: met again with another rating, it is settled by the merge policy and
+// every list sees the result
+using CatalogId = SongId;
+
+class SongCatalog {
+private:
+    StringPool strings;                    // titles and keys stored per song, artists interned
+    std::vector<StringId> titles;          // id -> title as first seen
+    std::vector<StringId> artists;
+    std::vector<StringId> keys;            // id -> songKey of title and artist
+    std::vector<std::uint8_t> ratings;
+    std::vector<std::uint32_t> uses;       // id -> list entries holding the song, 0 for a free slot
+    std::vector<CatalogId> freeIds;
+    FlatStringMap byKey;                   // songKey -> id
+    // title index, built by the first lookup by title so loading lists does not pay for it
+    mutable FlatStringMap byTitle;         // trimmed lowercase title -> one song with it, keyed on the title part of its songKey
+    mutable std::vector<CatalogId> sameTitleNext; // id -> next song with the same title (another artist), or kNoSong
+    mutable bool titleIndexed = false;
+    std::size_t songCount = 0;
+    MergePolicy mergePolicy = MergePolicy::KEEP_LAST;
+    std::string keyBuffer;                 // reused for building keys
+
+    // the title part of a song's key, the text before its comma
+    std::string_view titleKeyOf(CatalogId id) const {
+        std::string_view key = strings.view(keys[id]);
+        return key.substr(0, key.find(','));
+    }
+
+    // put a song at the head of its title's chain
+    void linkTitle(CatalogId id) const {
+        auto inserted = byTitle.insert(titleKeyOf(id), id);
+        sameTitleNext[id] = kNoSong;
+        if (inserted.second) return;
+        sameTitleNext[id] = *inserted.first;
+        *inserted.first = id;
+        byTitle.moveKey(titleKeyOf(id), titleKeyOf(id));
+    }
+
+    // index every song by title, done once on the first lookup by title
+    void buildTitleIndex() const {
+        if (titleIndexed) return;
+        byTitle.reserve(songCount);
+        sameTitleNext.assign(titles.size(), kNoSong);
+        for (CatalogId id = 0; id < titles.size(); ++id)
+            if (uses[id] > 0) linkTitle(id);
+        titleIndexed = true;
+    }
+
+    // take a song out of its title's chain, before its key text is released
+    void unlinkTitle(CatalogId id) {
+        std::uint32_t* head = byTitle.find(titleKeyOf(id));
+        if (*head == id) {
+            *head = sameTitleNext[id];
+            if (*head == kNoSong) byTitle.erase(titleKeyOf(id));
+            else byTitle.moveKey(titleKeyOf(id), titleKeyOf(*head));
+            return;
+        }
+        CatalogId before = *head;
+        while (sameTitleNext[before] != id) before = sameTitleNext[before];
+        sameTitleNext[before] = sameTitleNext[id];
+    }
+
+public:
+    // take one use of the song with this title and artist, storing it the first time; returns its id
+    // and sets rerated when a song already there got another rating
+    CatalogId acquire(std::string_view title, std::string_view artist, int rating, bool& rerated) {
+        songKey(title, artist, keyBuffer);
+        rating = std::clamp(rating, kMinRating, kMaxRating); // as insertSong, a rating always fits 1-5
+        rerated = false;
+        if (const std::uint32_t* found = byKey.find(keyBuffer)) {
+            CatalogId id = *found;
+            int merged = mergeRating(mergePolicy, ratings[id], rating);
+            rerated = merged != ratings[id];
+            ratings[id] = std::uint8_t(merged);
+            ++uses[id];
+            return id;
+        }
+        CatalogId id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        else {
+            id = CatalogId(titles.size());
+            titles.push_back(0);
+            artists.push_back(0);
+            keys.push_back(0);
+            ratings.push_back(0);
+            uses.push_back(0);
+            if (titleIndexed) sameTitleNext.push_back(kNoSong);
+        }
+        titles[id] = strings.add(title);
+        artists[id] = strings.intern(artist);
+        keys[id] = strings.add(keyBuffer);
+        ratings[id] = std::uint8_t(rating);
+        uses[id] = 1;
+        byKey.insert(strings.view(keys[id]), id);
+        if (titleIndexed) linkTitle(id);
+        ++songCount;
+        return id;
+    }
+
+    // give back one use of a song; the last one frees its slot
+    void release(CatalogId id) {
+        if (--uses[id] > 0) return;
+        byKey.erase(strings.view(keys[id]));
+        if (titleIndexed) unlinkTitle(id);
+        strings.release(titles[id]);
+        strings.release(keys[id]);
+        freeIds.push_back(id);
+        --songCount;
+    }
+
+    // id of the song with this title and artist, or kNoSong
+    CatalogId find(std::string_view title, std::string_view artist) {
+        songKey(title, artist, keyBuffer);
+        const std::uint32_t* found = byKey.find(keyBuffer);
+        return found ? *found : kNoSong;
+    }
+
+    // call fn(id) for every song with this title (case and surrounding spaces ignored), whatever its artist
+    template <typename Fn>
+    void forEachWithTitle(std::string_view title, Fn fn) const {
+        buildTitleIndex();
+        const std::uint32_t* head = byTitle.findFolded(trimmed(title));
+        for (CatalogId id = head ? *head : kNoSong; id != kNoSong; id = sameTitleNext[id]) fn(id);
+    }
+
+    std::string_view titleOf(CatalogId id) const { return strings.view(titles[id]); }
+    std::string_view artistOf(CatalogId id) const { return strings.view(artists[id]); }
+    int ratingOf(CatalogId id) const { return ratings[id]; }
+    Song songOf(CatalogId id) const { return Song(std::string(titleOf(id)), std::string(artistOf(id)), ratingOf(id)); }
+
+    // songs held, each counted once however many lists hold it
+    std::size_t size() const { return songCount; }
+
+    // how acquire settles the rating of a song that is already stored
+    void setMergePolicy(MergePolicy policy) { mergePolicy = policy; }
+
+    // bytes held by the columns, the key and title tables and the string pool
+    std::size_t memoryUsage() const {
+        return (titles.capacity() + artists.capacity() + keys.capacity()) * sizeof(StringId)
+            + ratings.capacity() + (uses.capacity() + freeIds.capacity() + sameTitleNext.capacity()) * sizeof(std::uint32_t)
+            + byKey.memoryUsage() + byTitle.memoryUsage() + strings.memoryUsage();
+    }
+};
+
+// Priority queue over a catalog: an indexed max-heap of song ids, ranked by the catalog's rating and then
+// by the order the songs were queued, each song at most once (as SongPriorityQueue, without the copies)
+// heap positions and queue numbers are columns indexed by id, so a queued song costs its 4-byte heap
+// entry; a rating changed through another list is put right with reposition()
+class CatalogQueue {
+private:
+    static constexpr std::uint32_t kNotQueued = 0xFFFFFFFFu;
+    const SongCatalog* catalog;
+    std::vector<CatalogId> heap;             // best song at heap[0]
+    std::vector<std::uint32_t> heapPos;      // id -> its position in heap, or kNotQueued
+    std::vector<std::uint32_t> queuedAs;     // id -> queue number, breaks rating ties (older first)
+    std::uint32_t nextNumber = 0;
+
+    bool ranksAbove(CatalogId a, CatalogId b) const {
+        if (catalog->ratingOf(a) != catalog->ratingOf(b)) return catalog->ratingOf(a) > catalog->ratingOf(b);
+        return queuedAs[a] < queuedAs[b];
+    }
+
+    void placeAt(std::size_t pos, CatalogId id) {
+        heap[pos] = id;
+        heapPos[id] = std::uint32_t(pos);
+    }
+
+    void siftUp(std::size_t pos) {
+        CatalogId id = heap[pos];
+        while (pos > 0) {
+            std::size_t parent = (pos - 1) / 2;
+            if (!ranksAbove(id, heap[parent])) break;
+            placeAt(pos, heap[parent]);
+            pos = parent;
+        }
+        placeAt(pos, id);
+    }
+
+    void siftDown(std::size_t pos) {
+        CatalogId id = heap[pos];
+        for (;;) {
+            std::size_t child = 2 * pos + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && ranksAbove(heap[child + 1], heap[child])) ++child;
+            if (!ranksAbove(heap[child], id)) break;
+            placeAt(pos, heap[child]);
+            pos = child;
+        }
+        placeAt(pos, id);
+    }
+
+public:
+    explicit CatalogQueue(const SongCatalog& songs) : catalog(&songs) {}
+
+    bool contains(CatalogId id) const { return id < heapPos.size() && heapPos[id] != kNotQueued; }
+
+    std::size_t size() const { return heap.size(); }
+
+    // queue a song, or return false when it is queued already; with ordered false the heap is left
+    // for restoreOrder() to fix, which is cheaper for a whole file
+    bool push(CatalogId id, bool ordered = true) {
+        if (contains(id)) return false;
+        if (id >= heapPos.size()) {
+            std::size_t size = std::max<std::size_t>(id + 1, 2 * heapPos.size());
+            heapPos.resize(size, kNotQueued);
+            queuedAs.resize(size, 0);
+        }
+        queuedAs[id] = nextNumber++;
+        heap.push_back(id);
+        heapPos[id] = std::uint32_t(heap.size() - 1);
+        if (ordered) siftUp(heap.size() - 1);
+        return true;
+    }
+
+    // take a queued song out
+    void erase(CatalogId id) {
+        std::size_t pos = heapPos[id];
+        CatalogId last = heap.back();
+        heap.pop_back();
+        heapPos[id] = kNotQueued;
+        if (pos < heap.size()) {
+            placeAt(pos, last);
+            siftUp(pos);
+            siftDown(heapPos[last]);
+        }
+    }
+
+    // move a queued song to its place after its rating changed
+    void reposition(CatalogId id) {
+        if (!contains(id)) return;
+        siftUp(heapPos[id]);
+        siftDown(heapPos[id]);
+    }
+
+    // rebuild the heap bottom-up in O(n), after unordered pushes or many rating changes
+    void restoreOrder() {
+        for (std::size_t pos = heap.size() / 2; pos-- > 0;) siftDown(pos);
+    }
+
+    // the queued song with this title (case and surrounding spaces ignored) that was queued first, or kNoSong
+    // (only the catalog's songs with that title are looked at, not the whole queue)
+    CatalogId findTitle(std::string_view title) const {
+        CatalogId best = kNoSong;
+        catalog->forEachWithTitle(title, [&](CatalogId id) {
+            if (contains(id) && (best == kNoSong || queuedAs[id] < queuedAs[best])) best = id;
+        });
+        return best;
+    }
+
+    // call fn(id) for the k best songs in order, through a frontier heap as SongPriorityQueue::forEachTop
+    template <typename Fn>
+    void forEachTop(std::size_t k, Fn fn) const {
+        if (heap.empty() || k == 0) return;
+        auto lower = [this](std::size_t a, std::size_t b) { return ranksAbove(heap[b], heap[a]); };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(lower)> frontier(lower);
+        frontier.push(0);
+        for (std::size_t visited = 0; visited < k && !frontier.empty(); ++visited) {
+            std::size_t pos = frontier.top();
+            frontier.pop();
+            fn(heap[pos]);
+            if (2 * pos + 1 < heap.size()) frontier.push(2 * pos + 1);
+            if (2 * pos + 2 < heap.size()) frontier.push(2 * pos + 2);
+        }
+    }
+
+    // the queued ids, in heap order
+    const std::vector<CatalogId>& ids() const { return heap; }
+
+    // bytes held by the heap and the columns
+    std::size_t memoryUsage() const {
+        return heap.capacity() * sizeof(CatalogId) + (heapPos.capacity() + queuedAs.capacity()) * sizeof(std::uint32_t);
+    }
+};
+
+// Named playlists and priority queues over one catalog
+// a playlist is its songs' ids in order (a song may appear more than once); a queue is a CatalogQueue
+// names are matched ignoring case; a song is found by title through the catalog's title index, though
+// taking it off a playlist still scans that playlist for its first position
+class PlaylistLibrary {
+private:
+    struct NamedPlaylist {
+        std::string name;
+        std::vector<CatalogId> ids;
+    };
+    struct NamedQueue {
+        std::string name;
+        CatalogQueue queue;
+    };
+    SongCatalog catalog;
+    std::vector<NamedPlaylist> playlists;
+    std::vector<NamedQueue> queues;
+
+    // the list of that name in playlists or queues, or nullptr
+    template <typename Lists>
+    static auto findNamed(Lists& lists, std::string_view name) -> decltype(&lists.front()) {
+        for (auto& list : lists)
+            if (equalsIgnoreCase(list.name, name)) return &list;
+        return nullptr;
+    }
+
+    // a song whose rating changed may have to move in every queue holding it
+    void repositionEverywhere(CatalogId id) {
+        for (NamedQueue& list : queues) list.queue.reposition(id);
+    }
+
+    // empty a list, giving back its songs' uses
+    void releaseAll(const std::vector<CatalogId>& ids) {
+        for (CatalogId id : ids) catalog.release(id);
+    }
+
+    void printHeader() const {
+        std::cout << std::setw(35) << std::left << "TITLE"
+            << std::setw(20) << std::left << "ARTIST"
+            << std::setw(10) << std::right << "RATING\n";
+        std::cout << std::setfill('-') << std::setw(65) << "" << std::setfill(' ') << '\n';
+    }
+
+    void printRow(CatalogId id) const {
+        std::cout << std::setw(35) << std::left << catalog.titleOf(id)
+            << std::setw(20) << std::left << catalog.artistOf(id)
+            << std::setw(5) << std::right << "[ " << catalog.ratingOf(id) << "/5 ] \n";
+    }
+
+public:
+    PlaylistLibrary() = default;
+    PlaylistLibrary(const PlaylistLibrary&) = delete; // the queues refer to the catalog
+    PlaylistLibrary& operator=(const PlaylistLibrary&) = delete;
+
+    // how a song met again with another rating is settled, on every list
+    void setMergePolicy(MergePolicy policy) { catalog.setMergePolicy(policy); }
+
+    bool hasList(const std::string& name) const {
+        return findNamed(playlists, name) || findNamed(queues, name);
+    }
+
+    // load a text or binary (".mplb") file as the named playlist or queue, replacing a list of that name;
+    // songs already in the catalog from other lists are not stored again
+    bool loadList(const std::string& name, const std::string& filename, bool asQueue) {
+        auto start = std::chrono::steady_clock::now();
+        if (asQueue ? findNamed(playlists, name) != nullptr : findNamed(queues, name) != nullptr) {
+            std::cerr << "'" << name << "' is already a " << (asQueue ? "playlist" : "queue") << ".\n";
+            return false;
+        }
+        std::vector<CatalogId> loaded;
+        std::size_t skipped = 0, storedBefore = catalog.size();
+        bool anyRerated = false;
+        CatalogQueue queue(catalog);
+        bool ok = forEachSongInFile(filename, [&](const SongFields& song) {
+            bool rerated = false;
+            CatalogId id = catalog.acquire(song.title, song.artist, song.rating, rerated);
+            anyRerated |= rerated;
+            if (asQueue && !queue.push(id, false)) catalog.release(id); // queued once, its rating merged
+            else loaded.push_back(id);
+        }, skipped);
+        if (!ok) {
+            releaseAll(loaded);
+            releaseAll(queue.ids());
+            return false;
+        }
+        std::size_t added = catalog.size() - storedBefore; // counted before a replaced list gives its songs back
+        if (asQueue) {
+            NamedQueue* list = findNamed(queues, name);
+            if (list) releaseAll(list->queue.ids());
+            else list = &queues.emplace_back(NamedQueue{ name, CatalogQueue(catalog) });
+            list->queue = std::move(queue);
+            list->queue.restoreOrder();
+        }
+        else {
+            NamedPlaylist* list = findNamed(playlists, name);
+            if (list) releaseAll(list->ids);
+            else list = &playlists.emplace_back(NamedPlaylist{ name, {} });
+            list->ids = std::move(loaded);
+        }
+        if (anyRerated)
+            for (NamedQueue& list : queues) list.queue.restoreOrder();
+        std::cout << (asQueue ? "Queue '" : "Playlist '") << name << "' loaded from " << filename << ": "
+            << (asQueue ? findNamed(queues, name)->queue.size() : findNamed(playlists, name)->ids.size()) << " songs, "
+            << added << " new to the catalog";
+        if (skipped > 0) std::cout << ", " << skipped << " unreadable lines skipped";
+        std::cout << " (" << elapsedMs(start) << " ms)\n";
+        return true;
+    }
+
+    // add a song to the end of a playlist, or queue it; false when there is no such list or the
+    // song is queued already (its rating is merged all the same)
+    bool addSong(const std::string& name, const Song& song) {
+        NamedPlaylist* playlist = findNamed(playlists, name);
+        NamedQueue* queued = playlist ? nullptr : findNamed(queues, name);
+        if (!playlist && !queued) return false;
+        bool rerated = false;
+        CatalogId id = catalog.acquire(song.title, song.artist, song.rating, rerated);
+        if (rerated) repositionEverywhere(id);
+        if (playlist) playlist->ids.push_back(id);
+        else if (!queued->queue.push(id)) {
+            catalog.release(id);
+            return false;
+        }
+        return true;
+    }
+
+    // remove the first song with this title (case and surrounding spaces ignored) from a playlist, or the
+    // one queued first from a queue; false when there is no such list or song
+    bool removeSong(const std::string& name, const std::string& title) {
+        if (NamedPlaylist* playlist = findNamed(playlists, name)) {
+            std::vector<CatalogId> wanted; // the songs with that title, usually one
+            catalog.forEachWithTitle(title, [&](CatalogId id) { wanted.push_back(id); });
+            if (wanted.empty()) return false;
+            auto found = std::find_if(playlist->ids.begin(), playlist->ids.end(),
+                [&](CatalogId id) { return std::find(wanted.begin(), wanted.end(), id) != wanted.end(); });
+            if (found == playlist->ids.end()) return false;
+            CatalogId id = *found;
+            playlist->ids.erase(found);
+            catalog.release(id);
+            return true;
+        }
+        if (NamedQueue* queued = findNamed(queues, name)) {
+            CatalogId id = queued->queue.findTitle(title);
+            if (id == kNoSong) return false;
+            queued->queue.erase(id);
+            catalog.release(id);
+            return true;
+        }
+        return false;
+    }
+
+    // call fn(id) for every song of a list: a playlist in its order, a queue best first
+    template <typename Fn>
+    bool forEachSong(const std::string& name, Fn fn) const {
+        if (const NamedPlaylist* playlist = findNamed(playlists, name)) {
+            for (CatalogId id : playlist->ids) fn(id);
+            return true;
+        }
+        if (const NamedQueue* queued = findNamed(queues, name)) {
+            queued->queue.forEachTop(queued->queue.size(), fn);
+            return true;
+        }
+        return false;
+    }
+
+    // write a list as "title,artist,rating" lines, in the order forEachSong gives
+    bool saveList(const std::string& name, const std::string& filename) const {
+        if (!hasList(name)) return false;
+        std::ofstream outFile(filename);
+        if (!outFile) {
+            std::cerr << "Error opening file for writing.\n";
+            return false;
+        }
+        forEachSong(name, [&](CatalogId id) {
+            outFile << catalog.titleOf(id) << ',' << catalog.artistOf(id) << ',' << catalog.ratingOf(id) << '\n';
+        });
+        std::cout << "'" << name << "' saved to " << filename << "\n";
+        return true;
+    }
+
+    // Display the songs of one list
+    bool displayList(const std::string& name) const {
+        if (!hasList(name)) return false;
+        std::cout << "********** " << name << " **********\n";
+        printHeader();
+        forEachSong(name, [this](CatalogId id) { printRow(id); });
+        return true;
+    }
+
+    // Display every list with its size, and what the shared catalog holds
+    void displayLists() const {
+        if (playlists.empty() && queues.empty()) {
+            std::cout << "No named playlists or queues loaded.\n";
+            return;
+        }
+        std::size_t entries = 0;
+        for (const NamedPlaylist& list : playlists) {
+            std::cout << std::setw(30) << std::left << list.name << "playlist, " << list.ids.size() << " songs\n";
+            entries += list.ids.size();
+        }
+        for (const NamedQueue& list : queues) {
+            std::cout << std::setw(30) << std::left << list.name << "queue, " << list.queue.size() << " songs\n";
+            entries += list.queue.size();
+        }
+        std::cout << entries << " list entries over " << catalog.size() << " catalog songs, "
+            << memoryUsage() / 1024 << " KB in all\n";
+    }
+
+    const SongCatalog& songs() const { return catalog; }
+
+    // bytes held by the catalog and every list
+    std::size_t memoryUsage() const {
+        std::size_t bytes = catalog.memoryUsage();
+        for (const NamedPlaylist& list : playlists) bytes += list.name.capacity() + list.ids.capacity() * sizeof(CatalogId);
+        for (const NamedQueue& list : queues) bytes += list.name.capacity() + list.queue.memoryUsage();
+        return bytes;
+    }
+};
+
+// Main application class
+class MusicPlaylistManager {
+private:
+    PlaylistJournal journal;  // playlist edits since PlayList.txt was last written
+    Playlist playlist;
+    UndoStack undoStack;
+    SongPriorityQueue priorityQueue;
+    PlaylistLibrary library;  // further named playlists and queues, sharing one copy of each song
+    std::string statsFile = "stats.txt";
+    std::string getCurrentTime() { //-https://www.w3schools.com/cpp/ref_ctime_asctime.asp
+                                   //-https://www.w3schools.com/cpp/cpp_date.asp
+        // Get current time from system clock
+        auto now = std::chrono::system_clock::now();
+        std::time_t time = std::chrono::system_clock::to_time_t(now);
+
+        // Convert to a readable format using std::localtime_r or std::localtime_s for thread safety
+        std::tm localTime;
+        #ifdef _WIN32
+                localtime_s(&localTime, &time);  // Use localtime_s on Windows
+        #else
+                localtime_r(&time, &localTime);  // Use localtime_r on POSIX systems
+        #endif
+
+        // Format the time (e.g., "YYYY-MM-DD HH:MM:SS")
+        std::stringstream timeStream;
+        timeStream << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S");
+
+        return timeStream.str();
+    }
+    
+public:
+    MusicPlaylistManager() : journal("PlayList.txt"), undoStack(playlist) {}
+    // Display the current time
+    void print_time() {
+        std::cout << std::setfill('*') << std::setw(20) << "" << std::setfill(' ');
+        std::cout << getCurrentTime(); 
+        std::cout << std::setfill('*') << std::setw(21) << "" << std::setfill(' ');
+    }
+    // make this round's playlist edits durable (one fsync), folding the journal into PlayList.txt when it has grown
+    void commitEdits() {
+        journal.commit();
+        if (journal.needsCompaction(playlist.size())) compactJournal();
+    }
+
+    // rewrite PlayList.txt with the current playlist and empty the journal
+    void compactJournal() {
+        if (playlist.compactJournal())
+            std::cout << "\nPlaylist saved to PlayList.txt\n"; // after the time line
+        else
+            std::cerr << "Error writing PlayList.txt, edits stay in " << journal.fileName() << ".\n";
+    }
+
+    // how the priority queue settles a song it already holds (on load and on add)
+    void setMergePolicy(MergePolicy policy) {
+        priorityQueue.setMergePolicy(policy);
+        library.setMergePolicy(policy);
+    }
+
+    // menu option 21: load, show, edit and save named playlists and queues
+    void manageLibrary() {
+        int action = 0;
+        std::cout << "  1. List named playlists and queues\n";
+        std::cout << "  2. Load a file as a named playlist\n";
+        std::cout << "  3. Load a file as a named queue\n";
+        std::cout << "  4. Display a playlist or queue\n";
+        std::cout << "  5. Add song to a playlist or queue\n";
+        std::cout << "  6. Remove song from a playlist or queue\n";
+        std::cout << "  7. Save a playlist or queue to a file\n";
+        std::cout << "Enter your choice: ";
+        std::cin >> action;
+        if (action < 1 || action > 7) {
+            std::cout << "Invalid choice. Please enter a number from 1 to 7.\n";
+            return;
+        }
+        if (action == 1) {
+            library.displayLists();
+            return;
+        }
+        std::string name, text;
+        std::cout << "Enter playlist or queue name: ";
+        std::cin.ignore();  // clear the newline
+        std::getline(std::cin, name);
+        if (action != 2 && action != 3 && !library.hasList(name)) {
+            std::cout << "No playlist or queue named '" << name << "'.\n";
+            return;
+        }
+        switch (action) {
+        case 2:
+        case 3:
+            std::cout << "Enter file name: ";
+            std::getline(std::cin, text);
+            library.loadList(name, text, action == 3);
+            break;
+        case 4:
+            library.displayList(name);
+            break;
+        case 5: {
+            std::string artist;
+            int rating = 0;
+            std::cout << "Enter song title: ";
+            std::getline(std::cin, text);
+            std::cout << "Enter artist: ";
+            std::getline(std::cin, artist);
+            std::cout << "Enter rating (1 to 5): ";
+            std::cin >> rating;
+            if (rating < kMinRating || rating > kMaxRating) std::cout << "Invalid rating. Please enter 1 to 5.\n";
+            else if (library.addSong(name, Song(text, artist, rating))) std::cout << "Song '" << text << "' added to '" << name << "'.\n";
+            else std::cout << "Song '" << text << "' is already in '" << name << "'.\n";
+            break;
+        }
+        case 6:
+            std::cout << "Enter song title to remove: ";
+            std::getline(std::cin, text);
+            if (library.removeSong(name, text)) std::cout << "Song '" << text << "' removed from '" << name << "'.\n";
+            else std::cout << "Song not found in '" << name << "'.\n";
+            break;
+        case 7:
+            std::cout << "Enter file name: ";
+            std::getline(std::cin, text);
+            library.saveList(name, text);
+            break;
+        }
+    }
+
+    // file the operation stats are written to at exit, when they are on
+    void setStatsFile(const std::string& filename) { statsFile = filename; }
+
+    //function to run the Main application
+    void run() {
        int choice;
-            playlist.loadFromFile("Playlist.txt");  // Load playlist on startup
-            priorityQueue.loadFromFile("songs.txt"); // Load playlist in the priorityqueue on startup
+            playlist.loadFromFile("PlayList.txt");  // Load playlist on startup
+            playlist.replayJournal(journal);        // then the edits made since it was written
+            if (journal.recordCount() > 0) compactJournal(); // each journal only holds ids of one session
+            // Load playlist in the priorityqueue on startup; copies of a song in songs.txt (older versions
+            // appended one line per add) are merged in the queue and written out once
+            if (priorityQueue.loadFromFile("songs.txt") > 0) priorityQueue.saveToFile("songs.txt");
                   do {
                         std::cout << '\n'<<std::setfill('*') << std::setw(60) << "" << std::setfill(' ') << '\n';
                         std::cout << std::setfill(' ') << std::setw(20) << "" << std::setfill(' ') << std::setw(20);
@@ -385,6 +4495,17 @@ public:
                         std::cout << "  8. Redo last undone action\n";
                         std::cout << "  9. Add song to priority queue\n";
                         std::cout << " 10. Display top songs in priority queue\n";
+                        std::cout << " 11. Display rating distribution\n";
+                        std::cout << " 12. Remove song from priority queue\n";
+                        std::cout << " 13. Change rating in priority queue\n";
+                        std::cout << " 14. Import songs from file\n";
+                        std::cout << " 15. Sort playlist by rating, artist and title\n";
+                        std::cout << " 16. Show songs by artist\n";
+                        std::cout << " 17. Shuffle play queue\n";
+                        std::cout << " 18. Show operation stats\n";
+                        std::cout << " 19. Turn operation stats " << (operationStats.enabled() ? "off" : "on") << "\n";
+                        std::cout << " 20. Display playlist sorted, without re-sorting it\n";
+                        std::cout << " 21. Named playlists and queues\n";
                         std::cout << "  \nEnter '0' to exit\n";
                         std::cout << std::setfill('*') << std::setw(60) << "" << std::setfill(' ') << '\n';
                         std::cout << "Enter your choice: ";
@@ -410,9 +4531,14 @@ public:
 
                         if (userInput == "yes") {
                             Song song(title, artist, rating);
-                            priorityQueue.addSong(song);
-                            std::cout << "Song '" << song.title << "' by " << song.artist << " added to the priority queue.\n";
-                            priorityQueue.saveSongToFile(song);  // save the song to the song text file                          
+                            if (priorityQueue.addSong(song)) {
+                                std::cout << "Song '" << song.title << "' by " << song.artist << " added to the priority queue.\n";
+                                priorityQueue.saveSongToFile(song);  // save the song to the song text file                          
+                            }
+                            else { // already queued, only its rating may have changed
+                                std::cout << "Song '" << song.title << "' by " << song.artist << " is already in the priority queue.\n";
+                                priorityQueue.saveToFile("songs.txt");
+                            }
                         }
                         else if (userInput == "no") {
                             std::cout << "Song '" << title << "' not added to the priority queue.\n";
@@ -422,9 +4548,7 @@ public:
                         }
 
                         Song song(title, artist, rating);
-                        playlist.addSong(song);
-                        undoStack.pushAction(UndoAction(UndoAction::ActionType::ADD, song)); // Push ADD action after adding the song
-                        playlist.saveToFile("PlayList.txt");                                  
+                        undoStack.addSong(song); // adds the song and logs it for undo
                         print_time();
                         break;
                     }
@@ -433,15 +4557,20 @@ public:
                         std::cout << "Enter song title to remove: ";
                         std::cin.ignore();  // clear the newline
                         std::getline(std::cin, title);
-                        Song songToRemove = playlist.findSong(title);  // Find the song object to store for undo
-                        if (songToRemove.title.empty()) {
+                        if (playlist.findSongId(title) == kNoSong) {
                             std::cout << "Song not found in the playlist.\n";
-                            std::cout << "Song related to the "<<title<<" in the playlist.\n";
-                            playlist.searchSong(title);
+                            std::vector<SongId> similar = playlist.fuzzyTitleIds(title); // typos like "Trublemaker"
+                            if (!similar.empty()) {
+                                std::cout << "Songs with a title close to " << title << ":\n";
+                                playlist.displaySongs(similar);
+                            }
+                            else {
+                                std::cout << "Song related to the "<<title<<" in the playlist.\n";
+                                playlist.searchSong(title);
+                            }
                         }
                         else {
-                            playlist.removeSong(title);
-                            undoStack.pushAction(UndoAction(UndoAction::ActionType::REMOVE, songToRemove));  // Push REMOVE action after removing the song
+                            undoStack.removeSong(title); // removes the song and logs it for undo
                         }
                         print_time();
 
@@ -463,7 +4592,7 @@ public:
                         break;
                     }
                     case 5: { // Sort playlist by rating
-                        playlist.sortByRating();
+                        undoStack.sortByRating();
                         playlist.displayPlaylist();
                         print_time();
                       
@@ -502,16 +4631,130 @@ public:
                         std::cin >> rating;
                         Song song(title, artist, rating);
                         priorityQueue.addSong(song);  
-                        playlist.saveToFile("PlayList.txt");
 
-                       
+                       
+                        print_time();
+                        
+                        break;
+                    }
+                    case 10://Display top songs in priority queue
+
+                        priorityQueue.displayTopSongs();
+                        print_time();
+
+                        break;
+                    case 11: //Display rating distribution
+                        playlist.displayRatingHistogram();
+                        print_time();
+
+                        break;
+                    case 12: { //Remove song from priority queue
+                        std::string title;
+                        std::cout << "Enter song title to remove from the priority queue: ";
+                        std::cin.ignore();  // clear the newline
+                        std::getline(std::cin, title);
+                        if (priorityQueue.removeSong(title)) {
+                            std::cout << "Song '" << title << "' removed from the priority queue.\n";
+                            priorityQueue.saveToFile("songs.txt");
+                        }
+                        else {
+                            std::cout << "Song '" << title << "' not found in the priority queue.\n";
+                        }
+                        print_time();
+
+                        break;
+                    }
+                    case 13: { //Change rating in priority queue
+                        std::string title;
+                        int rating = 0;
+                        std::cout << "Enter song title: ";
+                        std::cin.ignore();  // clear the newline
+                        std::getline(std::cin, title);
+                        std::cout << "Enter new rating (1 to 5): ";
+                        std::cin >> rating;
+                        if (rating < kMinRating || rating > kMaxRating) {
+                            std::cout << "Invalid rating. Please enter 1 to 5.\n";
+                        }
+                        else if (priorityQueue.updateRating(title, rating)) {
+                            std::cout << "Rating of '" << title << "' changed to " << rating << ".\n";
+                            priorityQueue.saveToFile("songs.txt");
+                        }
+                        else {
+                            std::cout << "Song '" << title << "' not found in the priority queue.\n";
+                        }
+                        print_time();
+
+                        break;
+                    }
+                    case 14: { //Import songs from file
+                        std::string filename;
+                        std::cout << "Enter file to import: ";
+                        std::cin.ignore();  // clear the newline
+                        std::getline(std::cin, filename);
+                        undoStack.importFromFile(filename); // one undo step for the whole file
+                        print_time();
+
+                        break;
+                    }
+                    case 15: { // Sort playlist by rating, then artist and title
+                        undoStack.sortByRatingArtistTitle();
+                        playlist.displayPlaylist();
+                        print_time();
+
+                        break;
+                    }
+                    case 16: { //Show songs by artist
+                        std::string artist;
+                        std::cout << "Enter artist: ";
+                        std::cin.ignore();  // clear the newline
+                        std::getline(std::cin, artist);
+                        playlist.displayArtist(artist);
+                        print_time();
+
+                        break;
+                    }
+                    case 17: { //Shuffle play queue
+                        std::size_t count = 0;
+                        std::cout << "How many songs to queue: ";
+                        std::cin >> count;
+                        if (playlist.size() == 0) std::cout << "The playlist is empty.\n";
+                        else {
+                            ShuffleQueue shuffle(playlist);
+                            std::cout << "********** SHUFFLE (weighted by rating) **********\n";
+                            playlist.displaySongs(shuffle.take(count));
+                        }
                         print_time();
-                        
+
                         break;
                     }
-                    case 10://Display top songs in priority queue
+                    case 18: //Show operation stats
+                        if (!operationStats.enabled()) std::cout << "Operation stats are off (option 19 turns them on).\n";
+                        else {
+                            std::cout << "********** OPERATION STATS **********\n";
+                            operationStats.writeReport(std::cout, false);
+                        }
+                        print_time();
 
-                        priorityQueue.displayTopSongs();
+                        break;
+                    case 19: //Turn operation stats on or off
+                        operationStats.setEnabled(!operationStats.enabled());
+                        std::cout << "Operation stats turned " << (operationStats.enabled() ? "on" : "off")
+                            << (operationStats.enabled() ? ", they are written to " + statsFile + " at exit.\n" : ".\n");
+                        print_time();
+
+                        break;
+                    case 20: { //Display a sorted view of the playlist
+                        int order = 0;
+                        std::cout << "Sort by (1) rating, (2) title or (3) artist: ";
+                        std::cin >> order;
+                        if (order < 1 || order > 3) std::cout << "Invalid choice. Please enter 1, 2 or 3.\n";
+                        else playlist.displaySorted(SortKey(order - 1));
+                        print_time();
+
+                        break;
+                    }
+                    case 21: //Named playlists and queues over the shared song catalog
+                        manageLibrary();
                         print_time();
 
                         break;
@@ -524,19 +4767,1338 @@ public:
                         std::cout << "Invalid choice. Please try again.\n";
                        
                     }                  
+                    commitEdits();
                   } while (choice != 0 );
+            if (journal.recordCount() > 0) compactJournal(); // start the next session from a clean snapshot
+            if (operationStats.enabled()) {
+                if (operationStats.dumpToFile(statsFile)) std::cout << "Operation stats written to " << statsFile << "\n";
+                else std::cerr << "Error writing " << statsFile << ".\n";
+            }
           
     } 
 };
 
+// ---------- Concurrent mode ----------
+// ConcurrentPlaylist lets several threads search a playlist while others edit it (a left-right scheme):
+// it holds two copies of the playlist, each with its own undo history. Readers use the published copy
+// and never wait for a writer, they only check in and out on a read indicator. Writers queue their
+// edits; the writer that takes the writer lock applies everything queued to the hidden copy, publishes
+// it, waits until no reader is left on the old copy and applies the same edits there. Edits do the same
+// thing to both copies, so they stay identical, and a whole batch of edits costs one publish.
+// A copy is published with everything its queries would build on first use already built
+// (Playlist::prepareReads), so readers sharing it only read.
+class ConcurrentPlaylist {
+public:
+    // an edit, run once on each copy: it must only depend on the playlist and undo history it is given
+    using Edit = std::function<void(Playlist&, UndoStack&)>;
+
+private:
+    // count of readers inside a copy, spread over counters on separate cache lines so readers
+    // on different cores do not all update the same one
+    class ReadIndicator {
+    private:
+        static constexpr std::size_t kCounters = 16;
+        struct alignas(64) Counter {
+            std::atomic<long> readers{ 0 };
+        };
+        Counter counters[kCounters];
+
+        static std::size_t counterOfThisThread() {
+            static thread_local std::size_t counter = std::hash<std::thread::id>()(std::this_thread::get_id()) % kCounters;
+            return counter;
+        }
+
+    public:
+        void arrive() { counters[counterOfThisThread()].readers.fetch_add(1); }
+        void depart() { counters[counterOfThisThread()].readers.fetch_sub(1); }
+
+        bool isEmpty() const {
+            for (const Counter& counter : counters)
+                if (counter.readers.load() != 0) return false;
+            return true;
+        }
+    };
+
+    struct Copy {
+        Playlist playlist;
+        UndoStack undoStack{ playlist };
+    };
+
+    Copy copies[2];
+    mutable ReadIndicator indicators[2];
+    std::atomic<int> published{ 0 };   // copy new readers use
+    std::atomic<int> readVersion{ 0 };  // indicator new readers check in on
+
+    std::mutex queueMutex;              // guards queued and queuedCount
+    std::vector<Edit> queued;
+    std::uint64_t queuedCount = 0;      // edits queued so far
+    std::mutex writerMutex;             // one writer applies and publishes at a time
+    std::uint64_t appliedCount = 0;     // edits applied to both copies (guarded by writerMutex)
+    std::uint64_t batchCount = 0;       // publishes so far (guarded by writerMutex)
+
+    static void waitUntilEmpty(const ReadIndicator& indicator) {
+        while (!indicator.isEmpty()) std::this_thread::yield();
+    }
+
+    // apply the queued edits up to (at least) edit number `ticket` and publish them
+    void applyQueued(std::uint64_t ticket) {
+        std::lock_guard<std::mutex> writer(writerMutex);
+        if (appliedCount >= ticket) return; // taken along by the batch of another writer
+        std::vector<Edit> batch;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            batch.swap(queued);
+            appliedCount = queuedCount;
+        }
+        int hidden = 1 - published.load();
+        for (const Edit& edit : batch) edit(copies[hidden].playlist, copies[hidden].undoStack);
+        copies[hidden].playlist.prepareReads(); // readers must find the indexes and views ready
+        published.store(hidden);
+
+        // readers that started before the publish may still be on the other copy: switch new readers
+        // to the other indicator, then wait for both indicators to drain
+        int previous = readVersion.load(), next = 1 - previous;
+        waitUntilEmpty(indicators[next]);
+        readVersion.store(next);
+        waitUntilEmpty(indicators[previous]);
+
+        Copy& old = copies[1 - hidden];
+        for (const Edit& edit : batch) edit(old.playlist, old.undoStack);
+        old.playlist.prepareReads();
+        ++batchCount;
+    }
+
+public:
+    ConcurrentPlaylist() {
+        for (Copy& copy : copies) {
+            copy.playlist.setVerbose(false);
+            copy.undoStack.setVerbose(false);
+        }
+    }
+
+    // call read(playlist) on the published copy and return what it returns; never waits for writers
+    // ids and string_views of the playlist are only valid inside the call, copy what has to outlive it
+    template <typename Fn>
+    auto read(Fn fn) const -> decltype(fn(std::declval<const Playlist&>())) {
+        struct CheckIn {
+            ReadIndicator& indicator;
+            explicit CheckIn(ReadIndicator& i) : indicator(i) { indicator.arrive(); }
+            ~CheckIn() { indicator.depart(); }
+        } checkIn(indicators[readVersion.load()]);
+        return fn(static_cast<const Playlist&>(copies[published.load()].playlist));
+    }
+
+    // apply an edit to both copies; it is visible to readers when this returns
+    // edits queued by other writers meanwhile are applied in the same batch
+    void update(Edit edit) {
+        std::uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queued.push_back(std::move(edit));
+            ticket = ++queuedCount;
+        }
+        applyQueued(ticket);
+    }
+
+    void addSong(const Song& song) {
+        update([song](Playlist&, UndoStack& undoStack) { undoStack.addSong(song); });
+    }
+
+    // add many songs in one edit, undone as one step
+    void addSongs(std::vector<Song> songs) {
+        update([songs = std::move(songs)](Playlist&, UndoStack& undoStack) {
+            undoStack.beginGroup();
+            for (const Song& song : songs) undoStack.addSong(song);
+            undoStack.endGroup();
+        });
+    }
+
+    void removeSong(const std::string& title) {
+        update([title](Playlist&, UndoStack& undoStack) { undoStack.removeSong(title); });
+    }
+
+    void sortByRating() {
+        update([](Playlist&, UndoStack& undoStack) { undoStack.sortByRating(); });
+    }
+
+    void sortByRatingArtistTitle() {
+        update([](Playlist&, UndoStack& undoStack) { undoStack.sortByRatingArtistTitle(); });
+    }
+
+    void undoAction() {
+        update([](Playlist&, UndoStack& undoStack) { undoStack.undoAction(); });
+    }
+
+    void redoAction() {
+        update([](Playlist&, UndoStack& undoStack) { undoStack.redoAction(); });
+    }
+
+    // songs whose title contains the text, copied out of the published copy
+    std::vector<Song> searchSongs(const std::string& title) const {
+        return read([&title](const Playlist& playlist) {
+            std::vector<Song> songs;
+            for (SongId id : playlist.searchTitleIds(title)) songs.push_back(playlist.getSong(id));
+            return songs;
+        });
+    }
+
+    // the k best-rated songs, copied out of the published copy
+    std::vector<Song> topSongs(std::size_t k) const {
+        return read([k](const Playlist& playlist) {
+            std::vector<Song> songs;
+            for (SongId id : playlist.topSongIds(k)) songs.push_back(playlist.getSong(id));
+            return songs;
+        });
+    }
+
+    std::size_t size() const {
+        return read([](const Playlist& playlist) { return playlist.size(); });
+    }
+
+    // publishes so far, and edits per publish on average
+    std::uint64_t batches() {
+        std::lock_guard<std::mutex> writer(writerMutex);
+        return batchCount;
+    }
+    double editsPerBatch() {
+        std::lock_guard<std::mutex> writer(writerMutex);
+        return batchCount ? double(appliedCount) / double(batchCount) : 0.0;
+    }
+
+    // true when both copies hold the same songs in the same order (for the stress test)
+    bool copiesMatch() {
+        std::lock_guard<std::mutex> writer(writerMutex);
+        std::ostringstream first, second;
+        copies[0].playlist.writeText(first);
+        copies[1].playlist.writeText(second);
+        return first.str() == second.str();
+    }
+};
+
+// ---------- Batch mode ----------
+// "--batch [file]" reads one command per line from the file (or stdin) and runs it on a playlist that
+// starts empty, with no menu or timestamps; results go to a buffered stdout, the summary to stderr:
+//   add <title>,<artist>,<rating>    remove <title>      sort           load <file>
+//   search <text>                    artist <text>       topk <k>       save <file>
+//   undo                             redo                import <file>  sort artist
+//   byartist <name>                  stats [on|off|reset]   view rating|title|artist
+//   fuzzy <title>
+// ("sort" orders by rating, "sort artist" by rating, then artist and title)
+// search, artist, byartist, topk, view and fuzzy print a "# <command>: <n> songs" line followed by the songs as file lines
+// (byartist lists one artist's songs, any case and surrounding spaces ignored, best rated first; view lists the
+// playlist in a sorted view's order without reordering it; fuzzy lists up to 10 songs whose title is a few
+// typos away, closest first);
+// load and save use the binary format for files ending in ".mplb"; add, remove, sort and import can be undone
+// (an import in one step), a load clears that history; "stats" prints the operation stats table (see
+// OperationStats) after a "# stats" line; blank lines and lines starting with # are skipped
+class BatchSession {
+private:
+    Playlist playlist;
+    UndoStack undoStack{ playlist };
+    std::string output;               // stdout is written in large blocks
+    std::size_t lineNumber = 0;
+    std::size_t errors = 0;
+    std::unordered_map<std::string, std::size_t> commandCounts;
+
+    static constexpr std::size_t kFlushBytes = 1 << 20;
+
+    void flush() {
+        std::cout.write(output.data(), std::streamsize(output.size()));
+        output.clear();
+    }
+
+    void error(const std::string& message) {
+        ++errors;
+        std::cerr << "line " << lineNumber << ": " << message << "\n";
+    }
+
+    static bool isBinaryFile(const std::string& filename) {
+        return filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".mplb") == 0;
+    }
+
+    void printSongs(std::string_view command, const std::vector<SongId>& ids) {
+        output += "# ";
+        output.append(command.data(), command.size());
+        output += ": " + std::to_string(ids.size()) + " songs\n";
+        for (SongId id : ids) {
+            std::string_view title = playlist.titleOf(id), artist = playlist.artistOf(id);
+            output.append(title.data(), title.size());
+            output += ',';
+            output.append(artist.data(), artist.size());
+            output += ',';
+            output += char('0' + playlist.ratingOf(id));
+            output += '\n';
+        }
+    }
+
+    void execute(std::string_view line) {
+        std::size_t space = line.find(' ');
+        std::string command(line.substr(0, space));
+        std::transform(command.begin(), command.end(), command.begin(), ::tolower);
+        std::string argument(space == std::string_view::npos ? std::string_view() : line.substr(space + 1));
+
+        if (command == "add") {
+            SongFields fields;
+            if (!parseSongFields(argument, fields)) return error("expected add <title>,<artist>,<rating>");
+            undoStack.addSong(Song(std::string(fields.title), std::string(fields.artist), fields.rating));
+        }
+        else if (command == "remove") undoStack.removeSong(argument);
+        else if (command == "search") printSongs(line, playlist.searchTitleIds(argument));
+        else if (command == "artist") printSongs(line, playlist.searchArtistIds(argument));
+        else if (command == "fuzzy") printSongs(line, playlist.fuzzyTitleIds(argument));
+        else if (command == "byartist") printSongs(line, playlist.songsByArtist(argument));
+        else if (command == "view") {
+            if (argument == "rating") printSongs(line, playlist.sortedIds(SortKey::RATING));
+            else if (argument == "title") printSongs(line, playlist.sortedIds(SortKey::TITLE));
+            else if (argument == "artist") printSongs(line, playlist.sortedIds(SortKey::ARTIST));
+            else return error("expected view rating, view title or view artist");
+        }
+        else if (command == "stats") {
+            if (argument == "on" || argument == "off") operationStats.setEnabled(argument == "on");
+            else if (argument == "reset") operationStats.reset();
+            else if (argument.empty()) {
+                std::ostringstream report;
+                operationStats.writeReport(report, false);
+                output += "# stats\n";
+                output += report.str();
+            }
+            else return error("expected stats, stats on, stats off or stats reset");
+        }
+        else if (command == "sort") {
+            if (argument == "artist") undoStack.sortByRatingArtistTitle();
+            else if (argument.empty()) undoStack.sortByRating();
+            else return error("expected sort or sort artist");
+        }
+        else if (command == "undo" || command == "redo") {
+            flush(); // these print their own status line
+            command == "undo" ? undoStack.undoAction() : undoStack.redoAction();
+        }
+        else if (command == "topk") {
+            std::size_t k = 0;
+            auto parsed = std::from_chars(argument.data(), argument.data() + argument.size(), k);
+            if (parsed.ec != std::errc()) return error("expected topk <k>");
+            printSongs(line, playlist.topSongIds(k));
+        }
+        else if (command == "load" || command == "save" || command == "import") {
+            if (argument.empty()) return error("expected " + command + " <file>");
+            flush(); // these print their own status line
+            if (command == "import") undoStack.importFromFile(argument);
+            else if (command == "load") {
+                undoStack.clear();
+                isBinaryFile(argument) ? playlist.loadFromBinaryFile(argument) : playlist.loadFromFile(argument);
+            }
+            else isBinaryFile(argument) ? playlist.saveToBinaryFile(argument) : playlist.saveToFile(argument);
+        }
+        else return error("unknown command '" + command + "'");
+        ++commandCounts[command];
+    }
+
+public:
+    BatchSession() {
+        playlist.setVerbose(false);
+        playlist.deferSearchIndex(); // scripts usually start with a run of adds
+    }
+
+    // run every command of the stream, returns the number of lines that failed
+    std::size_t run(std::istream& in) {
+        auto start = std::chrono::steady_clock::now();
+        std::string line;
+        while (std::getline(in, line)) {
+            ++lineNumber;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            execute(line);
+            if (output.size() >= kFlushBytes) flush();
+        }
+        flush();
+        std::cout.flush();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::size_t total = 0;
+        for (const auto& counted : commandCounts) total += counted.second;
+        std::cerr << "Batch: " << total << " commands in " << std::fixed << std::setprecision(3) << seconds << " s ("
+            << std::setprecision(0) << (seconds > 0 ? total / seconds : 0.0) << " commands/s)";
+        for (const char* name : { "add", "remove", "search", "artist", "byartist", "sort", "topk", "load", "save", "undo", "redo", "import", "stats", "view", "fuzzy" }) {
+            auto found = commandCounts.find(name);
+            if (found != commandCounts.end()) std::cerr << ", " << found->second << ' ' << name;
+        }
+        if (errors > 0) std::cerr << ", " << errors << " failed";
+        std::cerr << "; playlist has " << playlist.size() << " songs\n";
+        return errors;
+    }
+};
+
+// ---------- Benchmarks ----------
+// run the program with "--bench" for the whole suite as CSV, or "--bench-search", "--bench-storage",
+// "--bench-queue", "--bench-load", "--bench-binary", "--bench-journal", "--bench-catalog", "--bench-fuzzy" or
+// "--bench-parallel" for a single comparison, instead of opening the menu; "--generate <file>" writes a
+// synthetic library
+
+// shape of a synthetic library
+struct LibraryConfig {
+    std::size_t songs = 100000;
+    std::size_t artists = 0;          // 0: one artist for every 20 songs
+    double artistSkew = 0.0;          // Zipf exponent of artist popularity, 0 makes every artist equally likely
+    int ratingWeights[kMaxRating + 1] = { 0, 1, 1, 1, 1, 1 }; // relative share of each rating
+    double duplicateTitles = 0.0;     // fraction of songs that reuse an earlier song's title
+    unsigned seed = 1;
+};
+
+// build a synthetic library: titles and artists made of random syllables
+std::vector<Song> generateSyntheticSongs(const LibraryConfig& config) {
+    static const char* syllables[] = { "ka", "li", "ma", "no", "ra", "si", "ta", "lo", "ve", "ng",
+        "pa", "gi", "mu", "do", "ik", "aw", "sa", "be", "ni", "on", "ar", "hu", "ke", "ly" };
+    const std::size_t syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+    std::mt19937 rng(config.seed);
+    auto word = [&](int parts) {
+        std::string w;
+        for (int i = 0; i < parts; ++i) w += syllables[rng() % syllableCount];
+        return w;
+    };
+    // artists repeat across songs like in a real library; with a skew the first artists get most songs
+    std::vector<std::string> artists(std::max<std::size_t>(1, config.artists ? config.artists : config.songs / 20));
+    for (std::string& artist : artists) artist = word(2) + " " + word(2);
+    std::vector<double> popularity(artists.size());
+    for (std::size_t rank = 0; rank < artists.size(); ++rank) popularity[rank] = 1.0 / std::pow(double(rank + 1), config.artistSkew);
+    std::discrete_distribution<std::size_t> pickArtist(popularity.begin(), popularity.end());
+    std::discrete_distribution<int> pickRating(std::begin(config.ratingWeights), std::end(config.ratingWeights));
+    std::bernoulli_distribution duplicate(std::clamp(config.duplicateTitles, 0.0, 1.0));
+
+    std::vector<Song> library;
+    library.reserve(config.songs);
+    for (std::size_t i = 0; i < config.songs; ++i) {
+        std::string title = !library.empty() && duplicate(rng) ? library[rng() % library.size()].title
+            : word(2 + rng() % 2) + " " + word(2 + rng() % 3);
+        library.emplace_back(title, artists[pickArtist(rng)], pickRating(rng));
+    }
+    return library;
+}
+
+// uniform library of the given size, as used by the single-purpose benchmarks
+std::vector<Song> generateSyntheticSongs(std::size_t count, unsigned seed) {
+    LibraryConfig config;
+    config.songs = count;
+    config.seed = seed;
+    return generateSyntheticSongs(config);
+}
+
+// wall time of a callable in milliseconds
+template <typename Fn>
+double timeMs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// compare the old linear title scan with the trigram index
+void benchmarkSearch() {
+    const std::vector<std::string> queries = { "lo", "kali", "ng pa", "mamu", "zzz", "sarawo" };
+    const int rounds = 20;
+    std::cout << std::setw(10) << std::right << "SONGS" << std::setw(10) << "QUERY"
+        << std::setw(10) << "MATCHES" << std::setw(14) << "LINEAR ms" << std::setw(14) << "INDEX ms" << '\n';
+    for (std::size_t count : { std::size_t(10000), std::size_t(100000), std::size_t(1000000) }) {
+        std::vector<Song> library = generateSyntheticSongs(count, 42);
+        Playlist playlist;
+        playlist.setVerbose(false);
+        for (const Song& song : library) playlist.addSong(song);
+
+        for (const std::string& query : queries) {
+            std::size_t linearMatches = 0, indexMatches = 0;
+            double linear = timeMs([&] {
+                for (int r = 0; r < rounds; ++r) {
+                    // the scan searchSong used to do: lowercase every title and look for the query
+                    std::string lowerQuery = query;
+                    std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
+                    linearMatches = 0;
+                    for (const Song& song : library) {
+                        std::string lowerTitle = song.title;
+                        std::transform(lowerTitle.begin(), lowerTitle.end(), lowerTitle.begin(), ::tolower);
+                        if (lowerTitle.find(lowerQuery) != std::string::npos) ++linearMatches;
+                    }
+                }
+            });
+            double indexed = timeMs([&] {
+                for (int r = 0; r < rounds; ++r) indexMatches = playlist.searchTitleIds(query).size();
+            });
+            if (linearMatches != indexMatches) std::cout << "  result mismatch for '" << query << "'\n";
+            std::cout << std::setw(10) << count << std::setw(10) << query << std::setw(10) << indexMatches
+                << std::setw(14) << std::fixed << std::setprecision(3) << linear / rounds
+                << std::setw(14) << indexed / rounds << '\n';
+        }
+    }
+}
+
+// compare the memory and scan speed of the column storage with the old std::list<Song>
+void benchmarkStorage() {
+    const int rounds = 20;
+    std::cout << std::setw(10) << std::right << "SONGS" << std::setw(16) << "LIST B/SONG" << std::setw(16) << "COLUMN B/SONG"
+        << std::setw(14) << "LIST SCAN ms" << std::setw(16) << "PLAYLIST ms" << '\n';
+    for (std::size_t count : { std::size_t(10000), std::size_t(100000), std::size_t(1000000) }) {
+        std::vector<Song> library = generateSyntheticSongs(count, 42);
+        std::list<Song> songs(library.begin(), library.end());
+        Playlist playlist;
+        playlist.setVerbose(false);
+        for (const Song& song : library) playlist.addSong(song);
+
+        // a list node holds the Song plus two links, and each string spills to the heap past its inline buffer
+        std::size_t listBytes = 0;
+        for (const Song& song : songs) {
+            listBytes += sizeof(Song) + 2 * sizeof(void*);
+            if (song.title.capacity() > std::string().capacity()) listBytes += song.title.capacity() + 1;
+            if (song.artist.capacity() > std::string().capacity()) listBytes += song.artist.capacity() + 1;
+        }
+
+        // the generateTopPlaylist filter: how many songs are rated 4 or more
+        std::size_t listCount = 0, columnCount = 0;
+        double listScan = timeMs([&] {
+            for (int r = 0; r < rounds; ++r)
+                listCount = std::size_t(std::count_if(songs.begin(), songs.end(), [](const Song& s) { return s.rating >= 4; }));
+        });
+        double columnScan = timeMs([&] {
+            for (int r = 0; r < rounds; ++r) columnCount = playlist.countRatingAtLeast(4);
+        });
+        if (listCount != columnCount) std::cout << "  result mismatch\n";
+        std::cout << std::setw(10) << count << std::setw(16) << listBytes / count << std::setw(16) << playlist.memoryUsage() / count
+            << std::setw(14) << std::fixed << std::setprecision(3) << listScan / rounds
+            << std::setw(16) << columnScan / rounds << '\n';
+    }
+}
+
+// compare the old copy-and-pop display of std::priority_queue with reading the indexed heap in place
+void benchmarkQueue() {
+    const int rounds = 10;
+    std::cout << std::setw(10) << std::right << "SONGS" << std::setw(8) << "K"
+        << std::setw(18) << "COPY+POP ms" << std::setw(18) << "INDEXED TOPK ms" << '\n';
+    for (std::size_t count : { std::size_t(10000), std::size_t(100000), std::size_t(1000000) }) {
+        std::vector<Song> library = generateSyntheticSongs(count, 7);
+        SongPriorityQueue queue;
+        for (const Song& song : library) queue.addSong(song);
+        // the old queue gets the same songs (the indexed one drops repeated title+artist pairs)
+        std::priority_queue<Song, std::vector<Song>, CompareSongRating> oldQueue;
+        queue.forEachTop(queue.size(), [&](const Song& s) { oldQueue.push(s); });
+        for (std::size_t k : { std::size_t(10), std::size_t(100), queue.size() }) {
+            std::size_t seenOld = 0, seenNew = 0;
+            double copyPop = timeMs([&] {
+                for (int r = 0; r < rounds; ++r) {
+                    // what displayTopSongs used to do: copy the whole queue, then pop
+                    std::priority_queue<Song, std::vector<Song>, CompareSongRating> temp = oldQueue;
+                    for (seenOld = 0; seenOld < k && !temp.empty(); ++seenOld) temp.pop();
+                }
+            });
+            double indexed = timeMs([&] {
+                for (int r = 0; r < rounds; ++r) {
+                    seenNew = 0;
+                    queue.forEachTop(k, [&](const Song&) { ++seenNew; });
+                }
+            });
+            if (seenOld != seenNew) std::cout << "  result mismatch\n";
+            std::cout << std::setw(10) << count << std::setw(8) << k
+                << std::setw(18) << std::fixed << std::setprecision(3) << copyPop / rounds
+                << std::setw(18) << indexed / rounds << '\n';
+        }
+
+        // operations the old queue could not do at all
+        std::size_t changes = std::min<std::size_t>(count, 10000);
+        double rerate = timeMs([&] {
+            for (std::size_t i = 0; i < changes; ++i) queue.updateRating(library[i].title, 1 + int(i % 5));
+        });
+        double remove = timeMs([&] {
+            for (std::size_t i = 0; i < changes; ++i) queue.removeSong(library[i].title);
+        });
+        std::cout << std::setw(10) << count << "  update rating: " << rerate * 1000.0 / changes << " us/op"
+            << ", remove: " << remove * 1000.0 / changes << " us/op\n";
+    }
+}
+
+// time loading a generated library file: the old getline + stringstream parse against the mapped loaders
+void benchmarkLoad() {
+    const std::string filename = "bench_library.txt";
+    for (std::size_t count : { std::size_t(100000), std::size_t(1000000) }) {
+        {
+            std::vector<Song> library = generateSyntheticSongs(count, 11);
+            std::ofstream out(filename);
+            for (const Song& song : library) out << song.toString() << "\n";
+        }
+        std::cout << "---- " << count << " lines ----\n";
+        double oldParse = timeMs([&] {
+            // what both loaders used to do per line, before adding anything
+            std::ifstream in(filename);
+            std::vector<Song> parsed;
+            std::string line;
+            while (std::getline(in, line))
+                if (!line.empty()) parsed.push_back(Song::fromString(line));
+        });
+        std::size_t fields = 0;
+        double mappedParse = timeMs([&] {
+            MappedFile file(filename);
+            forEachSongLine(file.data(), [&](const SongFields&) { ++fields; });
+        });
+        Playlist playlist;
+        double playlistLoad = timeMs([&] { playlist.loadFromFile(filename); });
+        SongPriorityQueue queue;
+        double queueLoad = timeMs([&] { queue.loadFromFile(filename); });
+        std::cout << std::fixed << std::setprecision(1)
+            << "getline + stringstream parse only: " << oldParse << " ms\n"
+            << "mapped zero-copy parse only:       " << mappedParse << " ms\n"
+            << "Playlist::loadFromFile:            " << playlistLoad << " ms\n"
+            << "SongPriorityQueue::loadFromFile:   " << queueLoad << " ms\n";
+    }
+    std::remove(filename.c_str());
+}
+
+// compare saving and loading the text format with the binary format
+void benchmarkBinary() {
+    const std::string textFile = "bench_library.txt", binaryFile = "bench_library.mplb";
+    for (std::size_t count : { std::size_t(100000), std::size_t(1000000) }) {
+        Playlist playlist;
+        playlist.setVerbose(false);
+        for (const Song& song : generateSyntheticSongs(count, 13)) playlist.addSong(song);
+        std::cout << "---- " << count << " songs ----\n";
+        double saveText = timeMs([&] { playlist.saveToFile(textFile); });
+        double saveBinary = timeMs([&] { playlist.saveToBinaryFile(binaryFile); });
+        Playlist loaded;
+        double loadText = timeMs([&] { loaded.loadFromFile(textFile); });
+        double loadBinary = timeMs([&] { loaded.loadFromBinaryFile(binaryFile); });
+        // using the mapped file directly: open it and sum every rating, no Playlist at all
+        long long ratingSum = 0;
+        double mapped = timeMs([&] {
+            BinaryPlaylistView view(binaryFile);
+            for (std::size_t i = 0; i < view.size(); ++i) ratingSum += view.rating(i);
+        });
+        std::cout << std::fixed << std::setprecision(1)
+            << "save text:   " << std::setw(8) << saveText << " ms    save binary: " << std::setw(8) << saveBinary << " ms\n"
+            << "load text:   " << std::setw(8) << loadText << " ms    load binary: " << std::setw(8) << loadBinary << " ms\n"
+            << "open binary and read all ratings in place: " << mapped << " ms (sum " << ratingSum << ")\n";
+    }
+    std::remove(textFile.c_str());
+    std::remove(binaryFile.c_str());
+}
+
+// per-edit cost of rewriting the whole playlist file against appending a journal record
+void benchmarkJournal() {
+    const std::string textFile = "bench_library.txt";
+    const int edits = 200;
+    for (std::size_t count : { std::size_t(10000), std::size_t(100000) }) {
+        Playlist playlist;
+        playlist.setVerbose(false);
+        for (const Song& song : generateSyntheticSongs(count, 17)) playlist.addSong(song);
+        std::vector<Song> extra = generateSyntheticSongs(edits, 18);
+        std::cout << "---- " << count << " songs, " << edits << " adds ----\n";
+        std::ostringstream quiet;
+        std::streambuf* console = std::cout.rdbuf(quiet.rdbuf()); // saveToFile prints a line per call
+        double rewrite = timeMs([&] {
+            for (const Song& song : extra) {
+                playlist.addSong(song);
+                playlist.saveToFile(textFile);
+            }
+        });
+        std::cout.rdbuf(console);
+        for (int i = 0; i < edits; ++i) playlist.removeSong(extra[i].title);
+
+        PlaylistJournal journal(textFile);
+        journal.compact([&](std::ostream& out) { playlist.writeText(out); });
+        playlist.attachJournal(&journal);
+        double perEdit = timeMs([&] {
+            for (const Song& song : extra) {
+                playlist.addSong(song);
+                journal.commit(); // one fsync per edit, as in the menu
+            }
+        });
+        for (int i = 0; i < edits; ++i) playlist.removeSong(extra[i].title);
+        double batched = timeMs([&] {
+            for (const Song& song : extra) playlist.addSong(song);
+            journal.commit(); // one fsync for the whole batch
+        });
+        playlist.attachJournal(nullptr);
+        std::cout << std::fixed << std::setprecision(3)
+            << "rewrite file per edit:        " << std::setw(10) << rewrite / edits << " ms/edit\n"
+            << "journal + fsync per edit:     " << std::setw(10) << perEdit / edits << " ms/edit\n"
+            << "journal, one fsync per batch: " << std::setw(10) << batched / edits << " ms/edit\n";
+        std::remove(journal.fileName().c_str());
+    }
+    std::remove(textFile.c_str());
+}
+
+// compare loading several overlapping playlist files into a Playlist each with loading them as named
+// playlists over one song catalog: bytes held and load time for all the lists
+void benchmarkCatalog() {
+    const int lists = 4;
+    std::cout << std::setw(10) << std::right << "SONGS" << std::setw(8) << "LISTS" << std::setw(14) << "ENTRIES"
+        << std::setw(16) << "PLAYLISTS MB" << std::setw(14) << "CATALOG MB" << std::setw(16) << "PLAYLISTS ms"
+        << std::setw(14) << "CATALOG ms" << '\n';
+    for (std::size_t count : { std::size_t(10000), std::size_t(100000), std::size_t(1000000) }) {
+        // each list holds about three quarters of the library, in its own order
+        std::vector<Song> library = generateSyntheticSongs(count, 61);
+        std::mt19937 rng(62);
+        std::vector<std::string> files;
+        std::size_t entries = 0;
+        for (int i = 0; i < lists; ++i) {
+            files.push_back("bench_catalog_" + std::to_string(i) + ".txt");
+            std::shuffle(library.begin(), library.end(), rng);
+            std::ofstream out(files.back());
+            for (const Song& song : library) {
+                if (rng() % 4 == 0) continue;
+                out << song.toString() << '\n';
+                ++entries;
+            }
+        }
+        std::ostringstream quiet;
+        std::streambuf* console = std::cout.rdbuf(quiet.rdbuf()); // every load prints a summary line
+        std::size_t separateBytes = 0, sharedBytes = 0;
+        double separate = 0, shared = 0;
+        {
+            std::vector<std::unique_ptr<Playlist>> playlists;
+            separate = timeMs([&] {
+                for (const std::string& file : files) {
+                    playlists.push_back(std::make_unique<Playlist>());
+                    playlists.back()->loadFromFile(file);
+                }
+            });
+            for (const auto& playlist : playlists) separateBytes += playlist->memoryUsage();
+        }
+        {
+            PlaylistLibrary catalog;
+            shared = timeMs([&] {
+                for (int i = 0; i < lists; ++i) catalog.loadList("list " + std::to_string(i), files[i], false);
+            });
+            sharedBytes = catalog.memoryUsage();
+        }
+        std::cout.rdbuf(console);
+        std::cout << std::setw(10) << count << std::setw(8) << lists << std::setw(14) << entries
+            << std::setw(16) << std::fixed << std::setprecision(1) << separateBytes / 1048576.0
+            << std::setw(14) << sharedBytes / 1048576.0 << std::setw(16) << std::setprecision(0) << separate
+            << std::setw(14) << shared << '\n';
+        for (const std::string& file : files) std::remove(file.c_str());
+    }
+}
+
+// compare fuzzy title lookups through the title dictionary with working out the full edit distance to every
+// Song::title, for queries made by one or two typos in existing titles; both must find the same titles
+void benchmarkFuzzy() {
+    const std::size_t queries = 200;
+    std::cout << std::setw(10) << std::right << "SONGS" << std::setw(12) << "BUILD ms" << std::setw(16) << "INDEXED us/q"
+        << std::setw(18) << "BRUTE FORCE us/q" << std::setw(10) << "SPEEDUP" << '\n';
+    for (std::size_t count : { std::size_t(10000), std::size_t(100000), std::size_t(1000000) }) {
+        std::vector<Song> library = generateSyntheticSongs(count, 71);
+        Playlist playlist;
+        playlist.setVerbose(false);
+        for (const Song& song : library) playlist.addSong(song);
+        std::mt19937 rng(72);
+        std::vector<std::string> typos;
+        for (std::size_t i = 0; i < queries; ++i) {
+            std::string title = library[rng() % library.size()].title;
+            for (int edit = 0, edits = 1 + rng() % 2; edit < edits && title.size() > 1; ++edit) {
+                std::size_t at = rng() % title.size();
+                switch (rng() % 3) {
+                case 0: title.erase(at, 1); break;
+                case 1: title.insert(at, 1, char('a' + rng() % 26)); break;
+                default: title[at] = char('a' + rng() % 26); break;
+                }
+            }
+            typos.push_back(title);
+        }
+        double build = timeMs([&] { playlist.fuzzyTitleIds("warm up"); });
+
+        std::size_t treeFound = 0, bruteFound = 0;
+        double tree = timeMs([&] {
+            for (const std::string& typo : typos) treeFound += playlist.fuzzyTitleIds(typo, count).size();
+        });
+        std::vector<std::size_t> previous, current;
+        double brute = timeMs([&] {
+            for (const std::string& typo : typos) {
+                std::size_t maxDistance = typo.size() <= 4 ? 1 : typo.size() <= 8 ? 2 : 3;
+                for (const Song& song : library) {
+                    std::size_t full = std::max(typo.size(), song.title.size());
+                    if (boundedEditDistance(typo, song.title, full, previous, current) <= maxDistance) ++bruteFound;
+                }
+            }
+        });
+        std::cout << std::setw(10) << count << std::setw(12) << std::fixed << std::setprecision(1) << build
+            << std::setw(16) << tree * 1000 / queries << std::setw(18) << brute * 1000 / queries
+            << std::setw(9) << std::setprecision(0) << brute / tree << "x"
+            << (treeFound == bruteFound ? "" : "  result mismatch") << '\n';
+    }
+}
+
+// read the library options that follow a "--bench" or "--generate" switch:
+//   --songs N[,N...]  --artists N  --zipf S  --ratings w1,w2,w3,w4,w5  --duplicates F  --seed N
+// returns false (with a message) on an unknown option or a bad value
+bool parseLibraryOptions(int argc, char* argv[], int first, LibraryConfig& config, std::vector<std::size_t>& sizes) {
+    auto numbers = [](const std::string& text) {
+        std::vector<double> values;
+        std::stringstream ss(text);
+        std::string item;
+        while (std::getline(ss, item, ',')) values.push_back(std::atof(item.c_str()));
+        return values;
+    };
+    for (int i = first; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << "\n";
+            return false;
+        }
+        std::vector<double> values = numbers(argv[i + 1]);
+        if (values.empty() || std::any_of(values.begin(), values.end(), [](double v) { return v < 0; })) {
+            std::cerr << "Bad value for " << option << ": " << argv[i + 1] << "\n";
+            return false;
+        }
+        if (option == "--songs") {
+            sizes.clear();
+            for (double v : values) sizes.push_back(std::size_t(v));
+        }
+        else if (option == "--artists") config.artists = std::size_t(values[0]);
+        else if (option == "--zipf") config.artistSkew = values[0];
+        else if (option == "--duplicates") config.duplicateTitles = values[0];
+        else if (option == "--seed") config.seed = unsigned(values[0]);
+        else if (option == "--ratings" && values.size() == kMaxRating) {
+            for (int rating = kMinRating; rating <= kMaxRating; ++rating) config.ratingWeights[rating] = int(values[rating - 1]);
+        }
+        else {
+            std::cerr << "Unknown option " << option << "\n";
+            return false;
+        }
+    }
+    if (sizes.empty()) sizes.push_back(config.songs);
+    return true;
+}
+
+// write a synthetic library file (binary when the name ends in ".mplb"), for batch runs and load tests
+bool generateLibraryFile(const std::string& filename, LibraryConfig config) {
+    BinaryPlaylistWriter binary;
+    std::ofstream text;
+    bool isBinary = filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".mplb") == 0;
+    if (!isBinary) text.open(filename);
+    for (const Song& song : generateSyntheticSongs(config)) {
+        if (isBinary) binary.add(song.title, song.artist, song.rating);
+        else text << song.toString() << "\n";
+    }
+    bool written = isBinary ? binary.write(filename) != 0 : bool(text);
+    if (!written) std::cerr << "Error opening file for writing.\n";
+    else std::cout << "Generated " << config.songs << " songs in " << filename << "\n";
+    return written;
+}
+
+// scaling of the multi-threaded paths at 1, 2, 4 and 8 threads on a 1M song library: loading the text
+// file into the playlist and the priority queue, sorting by rating, artist and title, and listing every
+// song with generateTopPlaylist; each result is compared with the single-threaded one
+void benchmarkParallel() {
+    const std::string filename = "bench_library.txt";
+    LibraryConfig config;
+    config.songs = 1000000;
+    config.seed = 19;
+    std::ostringstream quiet;
+    std::streambuf* console = std::cout.rdbuf(quiet.rdbuf()); // the loads print a status line
+    if (!generateLibraryFile(filename, config)) {
+        std::cout.rdbuf(console);
+        return;
+    }
+    std::cout.rdbuf(console);
+    std::cout << "---- " << config.songs << " songs, " << std::thread::hardware_concurrency() << " cores ----\n"
+        << "threads  playlist load  queue load  sort rating/artist/title  top playlist listing  same result\n";
+    std::string serialOrder, serialListing, serialQueue;
+    for (std::size_t threads : { std::size_t(1), std::size_t(2), std::size_t(4), std::size_t(8) }) {
+        Playlist playlist;
+        playlist.setVerbose(false);
+        playlist.setThreads(threads);
+        SongPriorityQueue queue;
+        queue.setThreads(threads);
+        std::ostringstream listing;
+        std::cout.rdbuf(quiet.rdbuf());
+        double load = timeMs([&] { playlist.loadFromFile(filename); });
+        double queueLoad = timeMs([&] { queue.loadFromFile(filename); });
+        double sort = timeMs([&] { playlist.sortByRatingArtistTitle(); });
+        std::cout.rdbuf(listing.rdbuf());
+        double top = timeMs([&] { playlist.generateTopPlaylist(1); });
+        std::cout.rdbuf(console);
+        quiet.str("");
+
+        std::ostringstream order, queued;
+        playlist.writeText(order);
+        for (const Song& song : queue.topK(queue.size())) queued << song.toString() << "\n";
+        if (threads == 1) {
+            serialOrder = order.str();
+            serialListing = listing.str();
+            serialQueue = queued.str();
+        }
+        bool same = order.str() == serialOrder && listing.str() == serialListing && queued.str() == serialQueue;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(7) << threads
+            << std::setw(12) << load << " ms" << std::setw(9) << queueLoad << " ms"
+            << std::setw(23) << sort << " ms" << std::setw(19) << top << " ms"
+            << std::setw(13) << (same ? "yes" : "NO") << "\n";
+    }
+    std::remove(filename.c_str());
+}
+
+// "--stress [seconds]": reader threads search and read the top songs of a ConcurrentPlaylist while two
+// writer threads add, remove, sort and undo, with 1, 2, 4 and 8 readers in turn; every read checks
+// that what it sees is consistent (song count, bucket counts, order of ratings), every 256th one also
+// walks a sorted view and looks up a title with a typo, and at the end of each round both copies must
+// be identical. Returns false if any check failed.
+bool runStressTest(double seconds) {
+    const std::size_t librarySize = 100000, writers = 2;
+    std::vector<Song> library = generateSyntheticSongs(librarySize + 20000, 23);
+    std::cout << "---- " << librarySize << " songs, " << writers << " writers, " << seconds << " s per round, "
+        << std::thread::hardware_concurrency() << " cores ----\n"
+        << "readers      reads/s     writes/s  edits/publish  failed checks  copies match\n";
+    bool passed = true;
+    for (std::size_t readers : { std::size_t(1), std::size_t(2), std::size_t(4), std::size_t(8) }) {
+        ConcurrentPlaylist playlist;
+        playlist.addSongs(std::vector<Song>(library.begin(), library.begin() + librarySize));
+        std::atomic<bool> stop{ false };
+        std::atomic<std::uint64_t> reads{ 0 }, writes{ 0 }, failures{ 0 };
+        std::vector<std::thread> threads;
+        for (std::size_t r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r] {
+                std::mt19937 rng(unsigned(100 + r));
+                std::uint64_t done = 0;
+                while (!stop.load()) {
+                    const Song& song = library[rng() % library.size()];
+                    std::string query = song.title.substr(rng() % (song.title.size() - 3), 4);
+                    std::string typo = song.title;
+                    typo[rng() % typo.size()] = '#';
+                    bool consistent = playlist.read([&](const Playlist& p) {
+                        std::size_t total = p.countRatingAtLeast(kMinRating);
+                        std::vector<SongId> top = p.topSongIds(20);
+                        for (std::size_t i = 1; i < top.size(); ++i)
+                            if (p.ratingOf(top[i - 1]) < p.ratingOf(top[i])) return false;
+                        for (SongId id : p.searchTitleIds(query))
+                            if (p.titleOf(id).find(query) == std::string_view::npos || p.ratingOf(id) < kMinRating) return false;
+                        if (done % 256 == 0 && p.orderIds().size() != p.size()) return false;
+                        if (done % 256 == 0) {
+                            SortKey key = done % 512 == 0 ? SortKey::TITLE : SortKey::ARTIST;
+                            std::vector<SongId> sorted = p.sortedIds(key);
+                            if (sorted.size() != p.size()) return false;
+                            auto field = [&](SongId id) {
+                                std::string text(key == SortKey::TITLE ? p.titleOf(id) : trimmed(p.artistOf(id)));
+                                std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+                                return text;
+                            };
+                            for (std::size_t i = 1; i < sorted.size(); i += 97)
+                                if (field(sorted[i]) < field(sorted[i - 1])) return false;
+                            // one character off: the song itself is found while it is in the playlist
+                            std::vector<SongId> similar = p.fuzzyTitleIds(typo);
+                            if (similar.empty() && p.findSongId(song.title) != kNoSong) return false;
+                            for (SongId id : similar)
+                                if (p.ratingOf(id) < kMinRating) return false;
+                        }
+                        return total == p.size() && top.size() == std::min<std::size_t>(20, p.size());
+                    });
+                    if (!consistent) ++failures;
+                    ++done;
+                }
+                reads += done;
+            });
+        }
+        for (std::size_t w = 0; w < writers; ++w) {
+            threads.emplace_back([&, w] {
+                std::mt19937 rng(unsigned(200 + w));
+                std::uint64_t done = 0;
+                while (!stop.load()) {
+                    unsigned op = rng() % 100;
+                    if (op < 40) playlist.addSong(library[librarySize + rng() % 20000]);
+                    else if (op < 75) playlist.removeSong(library[rng() % library.size()].title);
+                    else if (op < 90) playlist.undoAction();
+                    else if (op < 99) playlist.redoAction();
+                    else if (rng() % 2) playlist.sortByRating();
+                    else playlist.sortByRatingArtistTitle();
+                    ++done;
+                }
+                writes += done;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop = true;
+        for (std::thread& thread : threads) thread.join();
+
+        // a rating sort right after an artist sort must leave the order as it is: it is stable, and the
+        // rating buckets follow every sort
+        auto text = [](const Playlist& p) {
+            std::ostringstream out;
+            p.writeText(out);
+            return out.str();
+        };
+        playlist.sortByRatingArtistTitle();
+        std::string byArtist = playlist.read(text);
+        playlist.sortByRating();
+        if (playlist.read(text) != byArtist) ++failures;
+
+        bool match = playlist.copiesMatch();
+        passed = passed && match && failures == 0;
+        std::cout << std::fixed << std::setprecision(0) << std::setw(7) << readers
+            << std::setw(13) << reads / seconds << std::setw(13) << writes / seconds
+            << std::setprecision(1) << std::setw(15) << playlist.editsPerBatch()
+            << std::setw(15) << failures.load() << std::setw(14) << (match ? "yes" : "NO") << "\n";
+    }
+    return passed;
+}
+
+// "--check-journal": sessions of random adds, removes, undos, redos and sorts on a playlist with a journal,
+// committed and compacted as the menu does; each session ends as if the program were killed, and the
+// next one must get exactly the songs and order the killed one had from the snapshot and the journal.
+// The first session removes a song, compacts while it can still be undone, then adds and undoes past it.
+// Returns false if any replay differed.
+bool checkJournalReplay() {
+    const std::string snapshot = "check_journal.txt";
+    { std::ofstream out(snapshot); out << "Alpha,A,5\nBravo,B,4\nCharlie,C,3\n"; }
+    std::remove(PlaylistJournal(snapshot).fileName().c_str());
+    std::vector<Song> songs = generateSyntheticSongs(30, 31);
+    std::mt19937 rng(41);
+    auto text = [](const Playlist& p) {
+        std::ostringstream out;
+        p.writeText(out);
+        return out.str();
+    };
+    const std::size_t sessions = 300;
+    std::size_t mismatches = 0;
+    std::string expected;
+    std::ostringstream quiet;
+    std::streambuf* console = std::cout.rdbuf(quiet.rdbuf());
+    for (std::size_t session = 0; session <= sessions; ++session) {
+        PlaylistJournal journal(snapshot);
+        Playlist playlist;
+        playlist.setVerbose(false);
+        playlist.loadFromFile(snapshot);
+        playlist.replayJournal(journal);
+        if (session > 0 && text(playlist) != expected) ++mismatches;
+        if (session == sessions) break;
+        if (journal.recordCount() > 0) playlist.compactJournal();
+        UndoStack undoStack(playlist, 20 + rng() % 200);
+        undoStack.setVerbose(false);
+        if (session == 0) {
+            undoStack.removeSong("Charlie");
+            undoStack.sortByRating();
+            playlist.compactJournal();
+            undoStack.addSong(Song("W", "W", 3));
+            for (int i = 0; i < 3; ++i) undoStack.undoAction();
+        }
+        for (std::size_t step = session == 0 ? 0 : rng() % 300; step > 0; --step) {
+            unsigned op = rng() % 100;
+            if (op < 35) undoStack.addSong(songs[rng() % songs.size()]);
+            else if (op < 55) undoStack.removeSong(songs[rng() % songs.size()].title);
+            else if (op < 75) undoStack.undoAction();
+            else if (op < 90) undoStack.redoAction();
+            else if (op < 95) undoStack.sortByRating();
+            else undoStack.sortByRatingArtistTitle();
+            journal.commit();
+            if (journal.needsCompaction(playlist.size()) || rng() % 50 == 0) playlist.compactJournal();
+        }
+        journal.commit();
+        expected = text(playlist);
+        // killed here: nothing more is written, the committed journal stays behind
+    }
+    std::cout.rdbuf(console);
+    std::remove(PlaylistJournal(snapshot).fileName().c_str());
+    std::remove(snapshot.c_str());
+    std::cout << sessions << " sessions replayed after a crash: " << mismatches << " differed\n";
+    return mismatches == 0;
+}
+
+// "--check-allocations": counts the heap allocations of add, remove, find and undo once the playlist has
+// settled (slots, string bytes, undo log and index storage are all reused from then on) and exits with 1
+// unless there are none; the counting replaces operator new, so it is only compiled in with
+// -DCOUNT_ALLOCATIONS
+#ifdef COUNT_ALLOCATIONS
+std::atomic<std::uint64_t> heapAllocations{ 0 };
+
+void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // GCC pairs free() with the standard new once inlined
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+bool checkSteadyStateAllocations() {
+#ifdef COUNT_ALLOCATIONS
+    Playlist playlist;
+    playlist.setVerbose(false);
+    UndoStack undoStack(playlist);
+    undoStack.setVerbose(false);
+    undoStack.setHistoryLimit(1000);
+    for (const Song& song : generateSyntheticSongs(10000, 21)) playlist.addSong(song);
+    playlist.searchTitleIds("a"); // builds the search index, which every add then updates
+    playlist.sortedIds(SortKey::TITLE); // and the sorted views
+    playlist.sortedIds(SortKey::ARTIST);
+    std::vector<Song> edits = generateSyntheticSongs(64, 22);
+    std::vector<std::string> lookups;
+    for (const Song& song : edits) lookups.push_back(song.title + " "); // other capitals would do as well
+    for (std::string& title : lookups) title.pop_back();
+
+    // add a song, remove it, undo both, then add and remove it again (which drops the redo steps)
+    std::size_t found = 0;
+    auto cycle = [&](std::size_t rounds) {
+        for (std::size_t round = 0; round < rounds; ++round) {
+            for (std::size_t i = 0; i < edits.size(); ++i) {
+                undoStack.addSong(edits[i]);
+                undoStack.removeSong(lookups[i]);
+                undoStack.undoAction();
+                undoStack.undoAction();
+                undoStack.addSong(edits[i]);
+                if (playlist.findSongId(lookups[i]) != kNoSong) ++found;
+                found += playlist.artistSongCount(edits[i].artist);
+                undoStack.removeSong(lookups[i]);
+            }
+        }
+    };
+    cycle(500); // until the slots, pool and logs have reached their size
+    std::uint64_t before = heapAllocations.load();
+    const std::size_t rounds = 500;
+    cycle(rounds);
+    std::uint64_t allocations = heapAllocations.load() - before;
+    std::cout << rounds * edits.size() << " add/remove/undo/find cycles on a " << playlist.size() << " song playlist: "
+        << allocations << " heap allocations (lookups found " << found << " songs)\n";
+    return allocations == 0;
+#else
+    std::cerr << "Allocation counting is not compiled in: build with -DCOUNT_ALLOCATIONS\n";
+    return false;
+#endif
+}
+
+// time every playlist, undo and priority queue operation on synthetic libraries and print one CSV row per
+// operation and size: benchmark,songs,operations,total_ms,ns_per_op
+// (the status lines the operations print are swallowed, only the CSV reaches stdout)
+void benchmarkSuite(LibraryConfig config, const std::vector<std::size_t>& sizes) {
+    const std::string textFile = "bench_suite.txt", binaryFile = "bench_suite.mplb";
+    std::ostream results(std::cout.rdbuf());
+    std::ostringstream quiet;
+    std::cout.rdbuf(quiet.rdbuf());
+    results << "benchmark,songs,operations,total_ms,ns_per_op\n";
+    std::cerr << "library: zipf " << config.artistSkew << ", duplicates " << config.duplicateTitles << ", seed " << config.seed << ", ratings";
+    for (int rating = kMinRating; rating <= kMaxRating; ++rating) std::cerr << ' ' << config.ratingWeights[rating];
+    std::cerr << "\n";
+
+    for (std::size_t count : sizes) {
+        config.songs = count;
+        std::vector<Song> library = generateSyntheticSongs(config);
+        std::mt19937 rng(config.seed + 1);
+        auto report = [&](const char* name, std::size_t operations, double ms) {
+            results << name << ',' << count << ',' << operations << ',' << std::fixed << std::setprecision(3) << ms
+                << ',' << std::setprecision(1) << (operations ? ms * 1e6 / operations : 0.0) << "\n";
+            quiet.str("");
+        };
+        // sample queries: parts of existing titles and artists, and whole titles for exact lookups
+        const std::size_t queryCount = std::min<std::size_t>(1000, count);
+        std::vector<std::string> titleQueries, artistQueries, titles;
+        for (std::size_t i = 0; i < queryCount; ++i) {
+            const Song& song = library[rng() % library.size()];
+            titleQueries.push_back(song.title.substr(rng() % (song.title.size() - 3), 4));
+            artistQueries.push_back(song.artist.substr(0, 5));
+            titles.push_back(song.title);
+        }
+
+        Playlist playlist;
+        playlist.setVerbose(false);
+        report("Playlist.addSong", count, timeMs([&] { for (const Song& song : library) playlist.addSong(song); }));
+        report("Playlist.searchSong (first)", 1, timeMs([&] { playlist.searchTitleIds(titleQueries[0]); }));
+        report("Playlist.searchSong", queryCount, timeMs([&] { for (const std::string& q : titleQueries) playlist.searchTitleIds(q); }));
+        report("Playlist.searchArtist", queryCount, timeMs([&] { for (const std::string& q : artistQueries) playlist.searchArtistIds(q); }));
+        report("Playlist.songsByArtist", queryCount, timeMs([&] { for (std::size_t i = 0; i < queryCount; ++i) playlist.songsByArtist(library[i].artist); }));
+        report("Playlist.artistAverageRating", queryCount, timeMs([&] { for (std::size_t i = 0; i < queryCount; ++i) playlist.artistAverageRating(library[i].artist); }));
+        report("Playlist.findSong", queryCount, timeMs([&] { for (const std::string& t : titles) playlist.findSong(t); }));
+        {
+            // whole titles with one letter changed, as a typed title with a typo
+            const std::size_t fuzzyCount = std::min<std::size_t>(100, queryCount);
+            std::vector<std::string> typos(titles.begin(), titles.begin() + fuzzyCount);
+            for (std::string& typo : typos) typo[typo.size() / 2] = 'x';
+            report("Playlist.fuzzyTitleIds (first)", 1, timeMs([&] { playlist.fuzzyTitleIds(typos[0]); }));
+            report("Playlist.fuzzyTitleIds", fuzzyCount, timeMs([&] { for (const std::string& t : typos) playlist.fuzzyTitleIds(t); }));
+        }
+        report("Playlist.sortByRating", 5, timeMs([&] { for (int r = 0; r < 5; ++r) playlist.sortByRating(); }));
+        report("Playlist.sortByRatingArtistTitle", 1, timeMs([&] { playlist.sortByRatingArtistTitle(); }));
+        report("Playlist.generateTopPlaylist(4)", 5, timeMs([&] { for (int r = 0; r < 5; ++r) playlist.generateTopPlaylist(4); }));
+        report("Playlist.sortedIds(title, first)", 1, timeMs([&] { playlist.sortedIds(SortKey::TITLE); }));
+        report("Playlist.sortedIds(artist, first)", 1, timeMs([&] { playlist.sortedIds(SortKey::ARTIST); }));
+        report("Playlist.saveToFile", count, timeMs([&] { playlist.saveToFile(textFile); }));
+        report("Playlist.saveToBinaryFile", count, timeMs([&] { playlist.saveToBinaryFile(binaryFile); }));
+        {
+            SongFilter filter;
+            filter.minRating = 4;
+            report("streamFilterFile(top 100)", count, timeMs([&] { streamFilterFile(textFile, "bench_filter.txt", filter, 100); }));
+            std::remove("bench_filter.txt");
+        }
+        {
+            ShuffleQueue shuffle(playlist, config.seed);
+            report("ShuffleQueue.rebuild", count, timeMs([&] { shuffle.rebuild(); }));
+            report("ShuffleQueue.next", count, timeMs([&] { for (std::size_t i = 0; i < count; ++i) shuffle.next(); }));
+        }
+        report("mergeSongFiles(2 copies)", 2 * count, timeMs([&] { mergeSongFiles({ textFile, textFile }, "bench_merge.txt", MergePolicy::KEEP_LAST); }));
+        std::remove("bench_merge.txt");
+        {
+            Playlist loaded;
+            report("Playlist.loadFromFile", count, timeMs([&] { loaded.loadFromFile(textFile); }));
+            report("Playlist.loadFromBinaryFile", count, timeMs([&] { loaded.loadFromBinaryFile(binaryFile); }));
+        }
+        report("Playlist.removeSong", queryCount, timeMs([&] { for (const std::string& t : titles) playlist.removeSong(t); }));
+        report("Playlist.sortedIds(title)", 5, timeMs([&] { for (int r = 0; r < 5; ++r) playlist.sortedIds(SortKey::TITLE); }));
+
+        // undo/redo of recent adds and removes, the way the menu records them
+        UndoStack undoStack(playlist);
+        const std::size_t undoCount = std::min<std::size_t>(10000, count);
+        for (std::size_t i = 0; i < undoCount; ++i) undoStack.addSong(library[i]);
+        report("UndoStack.undoAction(add)", undoCount, timeMs([&] { for (std::size_t i = 0; i < undoCount; ++i) undoStack.undoAction(); }));
+        report("UndoStack.redoAction(add)", undoCount, timeMs([&] { for (std::size_t i = 0; i < undoCount; ++i) undoStack.redoAction(); }));
+        report("UndoStack.removeSong", undoCount, timeMs([&] { for (std::size_t i = 0; i < undoCount; ++i) undoStack.removeSong(library[i].title); }));
+        report("UndoStack.undoAction(remove)", undoCount, timeMs([&] { for (std::size_t i = 0; i < undoCount; ++i) undoStack.undoAction(); }));
+        undoStack.sortByRating();
+        report("UndoStack.undoAction(sort)", 1, timeMs([&] { undoStack.undoAction(); }));
+
+        SongPriorityQueue queue;
+        report("SongPriorityQueue.addSong", count, timeMs([&] { for (const Song& song : library) queue.addSong(song); }));
+        report("SongPriorityQueue.topK(10)", queryCount, timeMs([&] { for (std::size_t i = 0; i < queryCount; ++i) queue.topK(10); }));
+        report("SongPriorityQueue.updateRating", queryCount, timeMs([&] {
+            for (std::size_t i = 0; i < queryCount; ++i) queue.updateRating(titles[i], 1 + int(i % 5));
+        }));
+        report("SongPriorityQueue.removeSong", queryCount, timeMs([&] { for (const std::string& t : titles) queue.removeSong(t); }));
+    }
+    std::cout.rdbuf(results.rdbuf());
+    std::remove(textFile.c_str());
+    std::remove(binaryFile.c_str());
+}
+
 // Main function
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        std::ios::sync_with_stdio(false);
+        BatchSession session;
+        if (argc > 2 && std::string(argv[2]) != "-") {
+            std::ifstream commands(argv[2]);
+            if (!commands) {
+                std::cerr << "Error opening file for reading.\n";
+                return 1;
+            }
+            return session.run(commands) == 0 ? 0 : 1;
+        }
+        return session.run(std::cin) == 0 ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        LibraryConfig config;
+        std::vector<std::size_t> sizes = { 10000, 100000 };
+        if (!parseLibraryOptions(argc, argv, 2, config, sizes)) return 1;
+        benchmarkSuite(config, sizes);
+        return 0;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--generate") {
+        LibraryConfig config;
+        std::vector<std::size_t> sizes;
+        if (!parseLibraryOptions(argc, argv, 3, config, sizes)) return 1;
+        config.songs = sizes.front();
+        return generateLibraryFile(argv[2], config) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-search") {
+        benchmarkSearch();
+        return 0;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--to-binary") {
+        return convertTextToBinary(argv[2], argv[3]) ? 0 : 1;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--to-text") {
+        return convertBinaryToText(argv[2], argv[3]) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-journal") {
+        benchmarkJournal();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-fuzzy") {
+        benchmarkFuzzy();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-catalog") {
+        benchmarkCatalog();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-binary") {
+        benchmarkBinary();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-load") {
+        benchmarkLoad();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-queue") {
+        benchmarkQueue();
+        return 0;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--filter") {
+        SongFilter filter;
+        std::size_t topK = 0;
+        if (!parseFilterOptions(argc, argv, 4, filter, topK)) return 1;
+        return streamFilterFile(argv[2], argv[3], filter, topK) ? 0 : 1;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--merge") {
+        std::vector<std::string> inFiles;
+        MergePolicy policy = MergePolicy::KEEP_LAST;
+        for (int i = 3; i < argc; ++i) {
+            if (std::string(argv[i]) != "--policy") inFiles.push_back(argv[i]);
+            else if (i + 1 >= argc) {
+                std::cerr << "Missing value for --policy\n";
+                return 1;
+            }
+            else if (!parseMergePolicy(argv[++i], policy)) return 1;
+        }
+        return mergeSongFiles(inFiles, argv[2], policy) ? 0 : 1;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--shuffle") {
+        std::size_t count = 100;
+        std::uint64_t seed = std::random_device{}();
+        for (int i = 3; i < argc; ++i) {
+            std::string option = argv[i];
+            const char* text = option == "--seed" && i + 1 < argc ? argv[++i] : argv[i];
+            std::size_t length = std::strlen(text);
+            auto parsed = option == "--seed" ? std::from_chars(text, text + length, seed) : std::from_chars(text, text + length, count);
+            if (parsed.ec != std::errc() || parsed.ptr != text + length) {
+                std::cerr << "Bad value for " << (option == "--seed" ? "--seed" : "count") << ": " << text << "\n";
+                return 1;
+            }
+        }
+        return streamShuffle(argv[2], count, seed) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--check-journal") {
+        return checkJournalReplay() ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--check-allocations") {
+        return checkSteadyStateAllocations() ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--stress") {
+        return runStressTest(argc > 2 ? std::atof(argv[2]) : 2.0) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-parallel") {
+        benchmarkParallel();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-storage") {
+        benchmarkStorage();
+        return 0;
+    }
+    MusicPlaylistManager manager;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--policy" && i + 1 < argc) { // merge policy for the priority queue and the named lists
+            MergePolicy policy;
+            if (!parseMergePolicy(argv[++i], policy)) return 1;
+            manager.setMergePolicy(policy);
+        }
+        else if (option == "--stats") { // operation stats on from the start, written to the file at exit
+            operationStats.setEnabled(true);
+            if (i + 1 < argc && argv[i + 1][0] != '-') manager.setStatsFile(argv[++i]);
+        }
+        else {
+            std::cerr << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
     std::cout << std::setfill('*') << std::setw(55) << "" << std::setfill(' ') << '\n';
     std::cout << "      -MUSIC PLAYLIST MANAGER-\n";
     std::cout << "     Programmed by: Ryan Morao\n";
     std::cout << "                    Ken Espera\n";
     std::cout << std::setfill('*') << std::setw(55) << "" << std::setfill(' ') << '\n';
-    MusicPlaylistManager manager;
     manager.run();
     return 0;
 }